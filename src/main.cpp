@@ -1,10 +1,18 @@
 // Saptapper: Automated GSF ripper for MusicPlayer2000.
 
+#include <algorithm>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <vector>
 #include "args.hxx"
+#include "saptapper/batch_ripper.hpp"
 #include "saptapper/cartridge.hpp"
+#include "saptapper/convert_options.hpp"
+#include "saptapper/inspection_cache.hpp"
+#include "saptapper/known_games.hpp"
+#include "saptapper/mp2k_driver.hpp"
+#include "saptapper/rom_analysis.hpp"
 #include "saptapper/saptapper.hpp"
 
 using namespace saptapper;
@@ -30,6 +38,14 @@ int main(int argc, const char** argv) {
     args::Flag force_arg(parser, "force",
                          "Save all songs including duplicated ones",
                          {'f', "force"});
+    args::Flag content_dedup_arg(
+        parser, "content-dedup",
+        "Also skip songs whose sequence data is identical to an earlier song",
+        {"content-dedup"});
+    args::Flag zip_arg(
+        parser, "zip",
+        "Save the files of each ROM into a single ZIP archive instead",
+        {"zip"});
     args::ValueFlag<std::filesystem::path> outdir_arg(
         parser, "directory",
         "The output directory (the default is the working directory)",
@@ -39,9 +55,40 @@ int main(int argc, const char** argv) {
     args::ValueFlag<std::string> gsfby_arg(
         parser, "name", "The creator name to be tagged to minigsfs", {"gsfby"},
         args::Options::HiddenFromUsage | args::Options::HiddenFromDescription);
-    args::Positional<std::filesystem::path> input_arg(
-        parser, "romfile", "The ROM file to be processed",
-        args::Options::Required);
+    args::Flag known_game_entry_arg(
+        parser, "known-game-entry",
+        "Print the known game table entries of the ROMs and quit",
+        {"known-game-entry"},
+        args::Options::HiddenFromUsage | args::Options::HiddenFromDescription);
+    args::ValueFlag<unsigned int> jobs_arg(
+        parser, "N",
+        "Process multiple ROMs with N workers (the default is the number of "
+        "CPUs)",
+        {'j', "jobs"});
+    args::ValueFlag<unsigned int> max_roms_arg(
+        parser, "N",
+        "Hold at most N ROMs in memory at once (the default is twice the "
+        "number of jobs, plus 2)",
+        {"max-roms"});
+    args::ValueFlag<unsigned int> threads_arg(
+        parser, "N",
+        "Compress the gsflib with N threads (the default is the number of "
+        "CPUs, shared out between jobs)",
+        {"threads"});
+    args::ValueFlag<std::filesystem::path> gsflib_store_arg(
+        parser, "directory",
+        "Reuse identical gsflibs from a store directory instead of "
+        "compressing them again",
+        {"gsflib-store"});
+    args::ValueFlag<std::filesystem::path> cache_arg(
+        parser, "directory",
+        "Remember the inspection results of ROMs in a directory", {"cache"});
+    args::ValueFlag<std::filesystem::path> list_arg(
+        parser, "listfile", "Read the ROM files to be processed from a file",
+        {"list"});
+    args::PositionalList<std::filesystem::path> input_arg(
+        parser, "romfile",
+        "The ROM files to be processed (directories are searched recursively)");
 
     try {
       if (argc < 2) throw args::Help(help.Name());
@@ -54,37 +101,109 @@ int main(int argc, const char** argv) {
       return EXIT_SUCCESS;
     }
 
-    const auto in_path = args::get(input_arg);
-    if (!exists(in_path)) {
-      std::cerr << in_path.string() << ": File does not exist" << std::endl;
+    std::vector<std::filesystem::path> inputs{args::get(input_arg)};
+    if (list_arg) {
+      const auto listed = BatchRipper::ReadListFile(args::get(list_arg));
+      inputs.insert(inputs.end(), listed.begin(), listed.end());
+    }
+    if (inputs.empty()) {
+      std::cerr << "No ROM files are specified." << std::endl;
       return EXIT_FAILURE;
     }
+    for (const auto& input : inputs) {
+      if (!exists(input)) {
+        std::cerr << input.string() << ": File does not exist" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (known_game_entry_arg) {
+      // The entries come from the heuristics, never from the table itself.
+      for (const auto& rom_path : BatchRipper::CollectRomFiles(inputs)) {
+        const Cartridge cartridge = Cartridge::LoadFromFile(rom_path);
+        const RomAnalysis analysis{
+            RomAnalysis::Analyze(cartridge.rom(), Mp2kDriver::scanner())};
+        Mp2kDriverParam param;
+        MinigsfDriverParam minigsf;
+        agbptr_t gsf_driver_addr = agbnullptr;
+        Saptapper::Inspect(cartridge, analysis, param, minigsf,
+                           gsf_driver_addr, true);
+        std::cout << KnownGames::FormatEntry(cartridge.rom(), param,
+                                             gsf_driver_addr)
+                  << std::endl;
+      }
+      return EXIT_SUCCESS;
+    }
+
+    std::string gsfby{args::get(gsfby_arg)};
+    if (gsfby != "Caitsith2") {
+      if (gsfby.empty()) {
+        gsfby = "Saptapper";
+      } else {
+        gsfby.insert(0, "Saptapper, with help of ");
+      }
+    }
 
+    ConvertOptions options;
+    options.set_gsfby(gsfby);
+    options.set_keep_duplicated(force_arg);
+    options.set_content_dedup(content_dedup_arg);
+    options.set_zip_output(zip_arg);
+    options.set_compression_threads(args::get(threads_arg));
+    options.set_gsflib_store(args::get(gsflib_store_arg));
+    options.set_cache_dir(args::get(cache_arg));
+
+    const bool batch = inputs.size() > 1 || list_arg || jobs_arg ||
+                       is_directory(inputs.front());
+    if (batch) {
+      if (basename_arg) {
+        std::cerr << "The output filename cannot be specified for multiple "
+                     "ROM files."
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      BatchRipper ripper;
+      ripper.set_jobs(args::get(jobs_arg));
+      ripper.set_max_cartridges(args::get(max_roms_arg));
+      ripper.set_inspect_only(inspect_arg);
+      ripper.set_outdir(args::get(outdir_arg));
+      ripper.set_options(options);
+
+      const auto results =
+          ripper.Run(BatchRipper::CollectRomFiles(inputs));
+      if (inspect_arg) {
+        for (const auto& result : results) {
+          if (result.report.empty()) continue;
+          std::cout << result.rom_path.string() << ":" << std::endl
+                    << std::endl
+                    << result.report << std::endl;
+        }
+      }
+
+      BatchRipper::WriteSummary(std::cerr, results);
+      const bool ok =
+          std::all_of(results.begin(), results.end(),
+                      [](const BatchRipper::Result& r) { return r.ok; });
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    const auto& in_path = inputs.front();
     Cartridge cartridge = Cartridge::LoadFromFile(in_path);
 
     if (inspect_arg) {
       Mp2kDriverParam param;
       MinigsfDriverParam minigsf;
       agbptr_t gsf_driver_addr = agbnullptr;
-      Saptapper::Inspect(cartridge, param, minigsf, gsf_driver_addr);
+      Saptapper::Inspect(cartridge, InspectionCache{options.cache_dir()},
+                         param, minigsf, gsf_driver_addr);
       Saptapper::PrintParam(param, minigsf);
     } else {
       const std::filesystem::path basename{
           basename_arg ? args::get(basename_arg) : in_path.stem()};
       const std::filesystem::path outdir{args::get(outdir_arg)};
 
-      std::string gsfby{args::get(gsfby_arg)};
-      if (gsfby != "Caitsith2") {
-        if (gsfby.empty()) {
-          gsfby = "Saptapper";
-        } else {
-          gsfby.insert(0, "Saptapper, with help of ");
-        }
-      }
-
-      bool keep_duplicated = force_arg;
-      Saptapper::ConvertToGsfSet(cartridge, basename, outdir, gsfby,
-                                 keep_duplicated);
+      Saptapper::ConvertToGsfSet(cartridge, basename, outdir, options);
     }
   } catch (std::exception& e) {
     std::cerr << e.what() << std::endl;
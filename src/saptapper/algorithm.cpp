@@ -0,0 +1,198 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "algorithm.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include "bytes.hpp"
+#include "cpu_features.hpp"
+#include "types.hpp"
+
+#ifdef SAPTAPPER_X86
+#include <immintrin.h>
+#endif
+
+namespace saptapper {
+
+namespace {
+
+constexpr agbsize_t kAlign = 4;
+
+// The maximum number of slices of a loose pattern.
+constexpr std::size_t kMaximumSlices = 8;
+
+// Appends the indices i (first <= i < count) of the words at base + 4 * i
+// that equal one of the keys. Returns the index of the first word it did not
+// look at.
+using WordScanner = std::size_t (*)(const char* base, std::size_t first,
+                                    std::size_t count, const WordKey* keys,
+                                    std::size_t key_count,
+                                    std::vector<std::size_t>& hits);
+
+std::size_t scan_words_scalar(const char* base, std::size_t first,
+                               std::size_t count, const WordKey* keys,
+                               std::size_t key_count,
+                               std::vector<std::size_t>& hits) {
+  for (std::size_t i = first; i < count; i++) {
+    std::uint32_t word;
+    std::memcpy(&word, base + i * kAlign, sizeof(word));
+    word = ReadInt32L(reinterpret_cast<const unsigned char*>(&word));
+    for (std::size_t j = 0; j < key_count; j++) {
+      if ((word & keys[j].mask) == keys[j].value) {
+        hits.push_back(i);
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+#ifdef SAPTAPPER_SSE2
+std::size_t scan_words_sse2(const char* base, std::size_t first,
+                             std::size_t count, const WordKey* keys,
+                             std::size_t key_count,
+                             std::vector<std::size_t>& hits) {
+  std::size_t i = first;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i words =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + i * kAlign));
+    __m128i any = _mm_setzero_si128();
+    for (std::size_t j = 0; j < key_count; j++) {
+      const __m128i mask = _mm_set1_epi32(static_cast<int>(keys[j].mask));
+      const __m128i value = _mm_set1_epi32(static_cast<int>(keys[j].value));
+      any = _mm_or_si128(
+          any, _mm_cmpeq_epi32(_mm_and_si128(words, mask), value));
+    }
+    auto mask =
+        static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(any)));
+    while (mask != 0) {
+      hits.push_back(i + count_trailing_zeros(mask));
+      mask &= mask - 1;
+    }
+  }
+  return i;
+}
+#endif
+
+#ifdef SAPTAPPER_X86
+SAPTAPPER_TARGET("avx2")
+std::size_t scan_words_avx2(const char* base, std::size_t first,
+                             std::size_t count, const WordKey* keys,
+                             std::size_t key_count,
+                             std::vector<std::size_t>& hits) {
+  std::size_t i = first;
+  for (; i + 8 <= count; i += 8) {
+    const __m256i words = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(base + i * kAlign));
+    __m256i any = _mm256_setzero_si256();
+    for (std::size_t j = 0; j < key_count; j++) {
+      const __m256i mask = _mm256_set1_epi32(static_cast<int>(keys[j].mask));
+      const __m256i value =
+          _mm256_set1_epi32(static_cast<int>(keys[j].value));
+      any = _mm256_or_si256(
+          any, _mm256_cmpeq_epi32(_mm256_and_si256(words, mask), value));
+    }
+    auto mask = static_cast<std::uint32_t>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(any)));
+    while (mask != 0) {
+      hits.push_back(i + count_trailing_zeros(mask));
+      mask &= mask - 1;
+    }
+  }
+  return i;
+}
+#endif
+
+#ifdef SAPTAPPER_X86
+SAPTAPPER_TARGET("avx2,avx512f")
+std::size_t scan_words_avx512(const char* base, std::size_t first,
+                              std::size_t count, const WordKey* keys,
+                              std::size_t key_count,
+                              std::vector<std::size_t>& hits) {
+  std::size_t i = first;
+  for (; i + 16 <= count; i += 16) {
+    const __m512i words = _mm512_loadu_si512(base + i * kAlign);
+    __mmask16 any = 0;
+    for (std::size_t j = 0; j < key_count; j++) {
+      const __m512i mask = _mm512_set1_epi32(static_cast<int>(keys[j].mask));
+      const __m512i value =
+          _mm512_set1_epi32(static_cast<int>(keys[j].value));
+      any |= _mm512_cmpeq_epi32_mask(_mm512_and_si512(words, mask), value);
+    }
+    auto mask = static_cast<std::uint32_t>(any);
+    while (mask != 0) {
+      hits.push_back(i + count_trailing_zeros(mask));
+      mask &= mask - 1;
+    }
+  }
+  return i;
+}
+#endif
+
+WordScanner select_word_scanner() {
+#ifdef SAPTAPPER_X86
+  // AVX-512BW implies the AVX-512F instructions used here.
+  if (CpuFeatures::Get().avx512bw()) return scan_words_avx512;
+  if (CpuFeatures::Get().avx2()) return scan_words_avx2;
+#ifdef SAPTAPPER_SSE2
+  return scan_words_sse2;
+#endif
+#endif
+  return scan_words_scalar;
+}
+
+}  // namespace
+
+std::vector<WordKey> slice_loose_pattern(std::string_view pattern,
+                                         unsigned int max_diff) {
+  // A match has fewer than threshold mismatches, so at least one of
+  // threshold disjoint slices is intact.
+  const std::size_t threshold = std::max(max_diff, 1u);
+  const std::size_t word_count = pattern.size() / kAlign;
+  const std::size_t leftover = pattern.size() % kAlign;
+
+  if (threshold > kMaximumSlices) return {};
+
+  // Leftover slices shorter than 2 bytes would match almost everywhere.
+  std::size_t slice_count = 0;
+  if (word_count >= threshold) {
+    slice_count = std::min(word_count, kMaximumSlices);
+  } else if (word_count + 1 == threshold && leftover >= 2) {
+    slice_count = threshold;
+  } else {
+    return {};
+  }
+
+  // The pattern is sliced into its 4-byte words (plus the leftover bytes when
+  // they are needed to have enough slices). A slice of a candidate at an
+  // aligned position is itself an aligned word, so all slices are looked up
+  // with one pass over the aligned words.
+  std::vector<WordKey> slices(slice_count);
+  for (std::size_t j = 0; j < slice_count; j++) {
+    const std::size_t size = std::min<std::size_t>(
+        kAlign, pattern.size() - j * kAlign);
+    WordKey& slice = slices[j];
+    slice.offset = static_cast<agbsize_t>(j * kAlign);
+    slice.value = 0;
+    slice.mask = 0;
+    for (std::size_t k = 0; k < size; k++) {
+      slice.value |= static_cast<std::uint32_t>(
+                         static_cast<unsigned char>(pattern[j * kAlign + k]))
+                     << (8 * k);
+      slice.mask |= 0xffu << (8 * k);
+    }
+  }
+  return slices;
+}
+
+void find_words(const char* base, std::size_t count, const WordKey* keys,
+                std::size_t key_count, std::vector<std::size_t>& hits) {
+  static const WordScanner scan = select_word_scanner();
+  const std::size_t scanned = scan(base, 0, count, keys, key_count, hits);
+  scan_words_scalar(base, scanned, count, keys, key_count, hits);
+}
+
+}  // namespace saptapper
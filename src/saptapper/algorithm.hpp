@@ -3,15 +3,18 @@
 #ifndef SAPTAPPER_ALGORITHM_HPP_
 #define SAPTAPPER_ALGORITHM_HPP_
 
-#include <array>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
+#include <iterator>
 #include <string_view>
+#include <vector>
 #include "types.hpp"
 
 namespace saptapper {
 
-static bool memcmp_loose(const char* buf1, const char* buf2, size_t n,
+inline bool memcmp_loose(const char* buf1, const char* buf2, size_t n,
                          unsigned int max_diff) {
   unsigned int diff = 0;
   for (size_t pos = 0; pos < n; pos++) {
@@ -22,36 +25,44 @@ static bool memcmp_loose(const char* buf1, const char* buf2, size_t n,
   return true;
 }
 
-static agbptr_t find_loose(std::string_view rom, std::string_view pattern,
-                           unsigned int max_diff, agbsize_t pos = 0) {
-  if (rom.size() < pattern.size()) return agbnullptr;
+/// A little-endian 4-byte word to look for, compared under a mask. The offset
+/// is the position of the word in the pattern it was taken from.
+struct WordKey {
+  agbsize_t offset;
+  std::uint32_t value;
+  std::uint32_t mask;
+};
 
-  constexpr agbsize_t align = 4;
-  for (agbsize_t offset = pos; offset < rom.size() - pattern.size();
-       offset += align) {
-    if (memcmp_loose(&rom[offset], pattern.data(), pattern.size(), max_diff))
-      return to_romptr(offset);
-  }
-  return agbnullptr;
-}
+/// Appends the indices i < count of the 4-byte words at base + 4 * i that
+/// equal one of the keys under its mask. The words are compared with SIMD
+/// where available.
+void find_words(const char* base, std::size_t count, const WordKey* keys,
+                std::size_t key_count, std::vector<std::size_t>& hits);
+
+/// Slices a pattern into disjoint word keys, at least one of which is intact
+/// wherever the pattern differs in fewer than max_diff bytes. Returns an empty
+/// list if the pattern is too short to be sliced that way.
+std::vector<WordKey> slice_loose_pattern(std::string_view pattern,
+                                         unsigned int max_diff);
 
-template <size_t _Size>
-static agbptr_t find_backwards(std::string_view rom,
-                               std::array<std::string_view, _Size> patterns,
+/// Finds the last position in hits that lies within length bytes before pos,
+/// at a multiple of 4 bytes from it. Given the sorted positions at which a
+/// set of patterns match, this is a backward search from pos for them.
+inline agbptr_t find_backwards(std::string_view rom,
+                               const std::vector<agbsize_t>& hits,
                                agbsize_t pos, agbsize_t length) {
   if (pos >= rom.size()) return agbnullptr;
 
   constexpr agbsize_t align = 4;
   assert(length % align == 0);
-  if (length < align || rom.size() < length) return agbnullptr;
+  if (length < align || rom.size() < length || pos < length)
+    return agbnullptr;
 
-  const agbsize_t max_pos = pos - align;
   const agbsize_t min_pos = pos - length;
-  for (agbsize_t offset = max_pos; offset >= min_pos; offset -= align) {
-    for (const auto& pattern : patterns) {
-      if (std::memcmp(&rom[offset], pattern.data(), pattern.size()) == 0)
-        return to_romptr(offset);
-    }
+  auto it = std::lower_bound(hits.begin(), hits.end(), pos);
+  while (it != hits.begin() && *std::prev(it) >= min_pos) {
+    --it;
+    if ((pos - *it) % align == 0) return to_romptr(*it);
   }
   return agbnullptr;
 }
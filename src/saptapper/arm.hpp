@@ -35,6 +35,35 @@ static constexpr agbptr_t arm_b_dest(const agbptr_t current,
   return current + 8 + offset;
 }
 
+static constexpr bool is_arm_bl(const armins_t ins) {
+  return (ins & 0xff000000) == 0xeb000000;
+}
+
+/// The first half of a Thumb BL pair, which holds the upper offset bits.
+static constexpr bool is_thumb_bl_high(const thumbins_t ins) {
+  return (ins & 0xf800) == 0xf000;
+}
+
+/// The second half of a Thumb BL pair, which holds the lower offset bits.
+static constexpr bool is_thumb_bl_low(const thumbins_t ins) {
+  return (ins & 0xf800) == 0xf800;
+}
+
+static constexpr agbptr_t thumb_bl_dest(const agbptr_t current,
+                                        const thumbins_t high,
+                                        const thumbins_t low) {
+  agbsize_t offset = static_cast<agbsize_t>(high & 0x7ff) << 12;
+  if ((offset & 0x400000) != 0) {
+    offset |= ~0x7fffff;
+  }
+  offset += static_cast<agbsize_t>(low & 0x7ff) << 1;
+
+  return current + 4 + offset;
+}
+
+static_assert(thumb_bl_dest(0x8000100, 0xf000, 0xf812) == 0x8000128);
+static_assert(thumb_bl_dest(0x8000100, 0xf7ff, 0xfffe) == 0x8000100);
+
 }  // namespace saptapper
 
 #endif
@@ -0,0 +1,406 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "batch_file_writer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup)
+#define SAPTAPPER_HAVE_IO_URING 1
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#endif
+#endif
+
+namespace saptapper {
+
+#ifdef SAPTAPPER_HAVE_IO_URING
+
+// A minimal io_uring, driven by the raw system calls.
+class BatchFileWriter::Uring {
+ public:
+  // Returns nullptr if io_uring, or one of the operations needed, is not
+  // available.
+  static std::unique_ptr<Uring> Create(const std::filesystem::path& directory);
+
+  ~Uring();
+
+  Uring(const Uring&) = delete;
+  Uring& operator=(const Uring&) = delete;
+
+  // Writes the files, and sets failed to the index of the first file that
+  // failed (or files.size()) and error to its error.
+  void Write(const std::vector<File>& files, std::size_t& failed,
+             std::error_code& error);
+
+ private:
+  static constexpr unsigned int kEntries = 256;
+  static constexpr std::uint64_t kIgnored = ~std::uint64_t{0};
+
+  // A write larger than this is always short on Linux.
+  static constexpr std::size_t kMaximumWriteSize = 0x7ffff000;
+
+  int ring_fd_ = -1;
+  int directory_fd_ = -1;
+  void* sq_ring_ = MAP_FAILED;
+  void* cq_ring_ = MAP_FAILED;
+  void* sqe_map_ = MAP_FAILED;
+  std::size_t sq_ring_size_ = 0;
+  std::size_t cq_ring_size_ = 0;
+  std::size_t sqe_map_size_ = 0;
+
+  unsigned int sq_entries_ = 0;
+  unsigned int* sq_tail_ = nullptr;
+  unsigned int sq_mask_ = 0;
+  unsigned int* sq_array_ = nullptr;
+  io_uring_sqe* sqes_ = nullptr;
+  unsigned int* cq_head_ = nullptr;
+  unsigned int* cq_tail_ = nullptr;
+  unsigned int cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  unsigned int local_tail_ = 0;
+
+  Uring() = default;
+
+  bool Supports(std::initializer_list<unsigned int> opcodes) const;
+
+  io_uring_sqe* NextSqe();
+
+  // Submits the queued entries, and calls handle(user_data, result) for each
+  // of the count completions.
+  template <typename Handler>
+  void SubmitAndWait(unsigned int count, Handler handle);
+};
+
+std::unique_ptr<BatchFileWriter::Uring> BatchFileWriter::Uring::Create(
+    const std::filesystem::path& directory) {
+  std::unique_ptr<Uring> uring{new Uring};
+
+  io_uring_params params{};
+  uring->ring_fd_ =
+      static_cast<int>(syscall(__NR_io_uring_setup, kEntries, &params));
+  if (uring->ring_fd_ < 0) return nullptr;
+
+  uring->sq_ring_size_ =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  uring->cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    uring->sq_ring_size_ =
+        std::max(uring->sq_ring_size_, uring->cq_ring_size_);
+  }
+
+  uring->sq_ring_ = mmap(nullptr, uring->sq_ring_size_,
+                         PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         uring->ring_fd_, IORING_OFF_SQ_RING);
+  if (uring->sq_ring_ == MAP_FAILED) return nullptr;
+  if (!single_mmap) {
+    uring->cq_ring_ = mmap(nullptr, uring->cq_ring_size_,
+                           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           uring->ring_fd_, IORING_OFF_CQ_RING);
+    if (uring->cq_ring_ == MAP_FAILED) return nullptr;
+  }
+  uring->sqe_map_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  uring->sqe_map_ = mmap(nullptr, uring->sqe_map_size_,
+                         PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         uring->ring_fd_, IORING_OFF_SQES);
+  if (uring->sqe_map_ == MAP_FAILED) return nullptr;
+
+  auto* sq = static_cast<char*>(uring->sq_ring_);
+  auto* cq = static_cast<char*>(single_mmap ? uring->sq_ring_
+                                            : uring->cq_ring_);
+  uring->sq_entries_ = params.sq_entries;
+  uring->sq_tail_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+  uring->sq_mask_ =
+      *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+  uring->sq_array_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+  uring->sqes_ = static_cast<io_uring_sqe*>(uring->sqe_map_);
+  uring->cq_head_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+  uring->cq_tail_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+  uring->cq_mask_ =
+      *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+  uring->cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  uring->local_tail_ = *uring->sq_tail_;
+
+  if (!uring->Supports({IORING_OP_UNLINKAT, IORING_OP_OPENAT, IORING_OP_WRITE,
+                        IORING_OP_CLOSE})) {
+    return nullptr;
+  }
+
+  const std::string directory_name{directory.empty() ? std::string{"."}
+                                                     : directory.string()};
+  uring->directory_fd_ =
+      open(directory_name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (uring->directory_fd_ < 0) return nullptr;
+  return uring;
+}
+
+BatchFileWriter::Uring::~Uring() {
+  if (sqe_map_ != MAP_FAILED) munmap(sqe_map_, sqe_map_size_);
+  if (cq_ring_ != MAP_FAILED) munmap(cq_ring_, cq_ring_size_);
+  if (sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_ring_size_);
+  if (ring_fd_ >= 0) close(ring_fd_);
+  if (directory_fd_ >= 0) close(directory_fd_);
+}
+
+void BatchFileWriter::Uring::Write(const std::vector<File>& files,
+                                   std::size_t& failed,
+                                   std::error_code& error) {
+  failed = files.size();
+  const auto fail = [&](std::size_t index, int error_number) {
+    if (index >= failed) return;
+    failed = index;
+    error = std::error_code{error_number, std::generic_category()};
+  };
+
+  // Two entries per file in each round: unlink and open, then write and
+  // close.
+  const std::size_t chunk_size = sq_entries_ / 2;
+  std::vector<int> fds;
+  std::vector<int> written;
+  std::vector<int> closed;
+  for (std::size_t begin = 0; begin < files.size(); begin += chunk_size) {
+    const std::size_t count = std::min(chunk_size, files.size() - begin);
+    fds.assign(count, -1);
+    written.assign(count, 0);
+    closed.assign(count, 0);
+
+    // The unlink fails for new files, so it is hard-linked to the open, which
+    // then runs regardless. O_EXCL keeps the open from truncating a file that
+    // could not be unlinked.
+    for (std::size_t i = 0; i < count; i++) {
+      const char* name = files[begin + i].name.c_str();
+
+      io_uring_sqe* unlink_sqe = NextSqe();
+      unlink_sqe->opcode = IORING_OP_UNLINKAT;
+      unlink_sqe->flags = IOSQE_IO_HARDLINK;
+      unlink_sqe->fd = directory_fd_;
+      unlink_sqe->addr = reinterpret_cast<std::uintptr_t>(name);
+      unlink_sqe->user_data = kIgnored;
+
+      io_uring_sqe* open_sqe = NextSqe();
+      open_sqe->opcode = IORING_OP_OPENAT;
+      open_sqe->fd = directory_fd_;
+      open_sqe->addr = reinterpret_cast<std::uintptr_t>(name);
+      open_sqe->len = 0666;
+      open_sqe->open_flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+      open_sqe->user_data = i;
+    }
+    SubmitAndWait(static_cast<unsigned int>(count * 2),
+                  [&](std::uint64_t user_data, int result) {
+                    if (user_data == kIgnored) return;
+                    if (result < 0) {
+                      fail(begin + user_data, -result);
+                    } else {
+                      fds[user_data] = result;
+                    }
+                  });
+
+    // The close is linked to the write, and cancelled if the write fails or
+    // is short.
+    unsigned int queued = 0;
+    for (std::size_t i = 0; i < count; i++) {
+      if (fds[i] < 0) continue;
+      const std::string& data = files[begin + i].data;
+
+      io_uring_sqe* write_sqe = NextSqe();
+      write_sqe->opcode = IORING_OP_WRITE;
+      write_sqe->flags = IOSQE_IO_LINK;
+      write_sqe->fd = fds[i];
+      write_sqe->addr = reinterpret_cast<std::uintptr_t>(data.data());
+      write_sqe->len = static_cast<std::uint32_t>(
+          std::min(data.size(), kMaximumWriteSize));
+      write_sqe->off = 0;
+      write_sqe->user_data = i * 2;
+
+      io_uring_sqe* close_sqe = NextSqe();
+      close_sqe->opcode = IORING_OP_CLOSE;
+      close_sqe->fd = fds[i];
+      close_sqe->user_data = i * 2 + 1;
+      queued += 2;
+    }
+    SubmitAndWait(queued, [&](std::uint64_t user_data, int result) {
+      (user_data % 2 == 0 ? written : closed)[user_data / 2] = result;
+    });
+
+    for (std::size_t i = 0; i < count; i++) {
+      if (fds[i] < 0) continue;
+      const std::string& data = files[begin + i].data;
+
+      int error_number = written[i] < 0 ? -written[i] : 0;
+      std::size_t offset = written[i] < 0 ? data.size() : written[i];
+      while (offset < data.size()) {
+        const ssize_t result = pwrite(fds[i], data.data() + offset,
+                                      data.size() - offset, offset);
+        if (result < 0) {
+          if (errno == EINTR) continue;
+          error_number = errno;
+          break;
+        }
+        offset += static_cast<std::size_t>(result);
+      }
+
+      if (closed[i] == -ECANCELED) {
+        if (close(fds[i]) != 0 && error_number == 0) error_number = errno;
+      } else if (closed[i] < 0 && error_number == 0) {
+        error_number = -closed[i];
+      }
+      if (error_number != 0) fail(begin + i, error_number);
+    }
+  }
+}
+
+bool BatchFileWriter::Uring::Supports(
+    std::initializer_list<unsigned int> opcodes) const {
+  constexpr unsigned int kProbeSize = 256;
+  std::vector<char> buffer(
+      sizeof(io_uring_probe) + kProbeSize * sizeof(io_uring_probe_op), 0);
+  auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+  if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe,
+              kProbeSize) < 0) {
+    return false;
+  }
+
+  return std::all_of(opcodes.begin(), opcodes.end(), [&](unsigned int op) {
+    return op <= probe->last_op &&
+           (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+  });
+}
+
+io_uring_sqe* BatchFileWriter::Uring::NextSqe() {
+  const unsigned int index = local_tail_ & sq_mask_;
+  sq_array_[index] = index;
+  io_uring_sqe* sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(io_uring_sqe));
+  local_tail_++;
+  return sqe;
+}
+
+template <typename Handler>
+void BatchFileWriter::Uring::SubmitAndWait(unsigned int count,
+                                           Handler handle) {
+  __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+
+  unsigned int submitted = 0;
+  unsigned int completed = 0;
+  while (completed < count) {
+    const long result =
+        syscall(__NR_io_uring_enter, ring_fd_, count - submitted,
+                count - completed, IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (result < 0) {
+      if (errno == EINTR) continue;
+      throw std::system_error(errno, std::generic_category(),
+                              "io_uring_enter failed");
+    }
+    submitted += static_cast<unsigned int>(result);
+
+    unsigned int head = *cq_head_;
+    const unsigned int tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++, completed++) {
+      const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+      handle(cqe.user_data, cqe.res);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+}
+
+#else
+
+class BatchFileWriter::Uring {};
+
+#endif
+
+BatchFileWriter::BatchFileWriter(std::filesystem::path directory,
+                                 bool use_io_uring)
+    : directory_(std::move(directory)), use_io_uring_{use_io_uring} {}
+
+BatchFileWriter::~BatchFileWriter() = default;
+
+void BatchFileWriter::Write(const std::vector<File>& files) {
+  if (files.empty()) return;
+
+#ifdef SAPTAPPER_HAVE_IO_URING
+  // The directory is opened on the first batch, once it surely exists.
+  if (use_io_uring_ && !uring_checked_) {
+    uring_ = Uring::Create(directory_);
+    uring_checked_ = true;
+  }
+  if (uring_ != nullptr) {
+    std::size_t failed = files.size();
+    std::error_code error;
+    uring_->Write(files, failed, error);
+    if (failed != files.size()) {
+      throw std::filesystem::filesystem_error(
+          "Unable to write the file",
+          directory_ / std::filesystem::u8path(files[failed].name), error);
+    }
+    return;
+  }
+#endif
+
+  WriteWithThreads(files);
+}
+
+void BatchFileWriter::WriteWithThreads(const std::vector<File>& files) const {
+  std::atomic<std::size_t> next_file{0};
+  std::mutex mutex;
+  std::size_t failed = files.size();
+  auto worker = [&]() {
+    for (;;) {
+      const std::size_t index = next_file++;
+      if (index >= files.size()) return;
+
+      const File& file = files[index];
+      const std::filesystem::path path{directory_ /
+                                       std::filesystem::u8path(file.name)};
+      std::error_code error;
+      std::filesystem::remove(path, error);
+
+      std::ofstream out(path, std::ios::out | std::ios::binary);
+      out.write(file.data.data(), file.data.size());
+      out.close();
+      if (!out) {
+        std::lock_guard<std::mutex> lock{mutex};
+        failed = std::min(failed, index);
+      }
+    }
+  };
+
+  const auto threads = static_cast<unsigned int>(std::min<std::size_t>(
+      {std::max(1u, std::thread::hardware_concurrency()), kMaximumThreads,
+       files.size()}));
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < threads; i++) workers.emplace_back(worker);
+  worker();
+  for (auto& thread : workers) thread.join();
+
+  if (failed != files.size()) {
+    throw std::filesystem::filesystem_error(
+        "Unable to write the file",
+        directory_ / std::filesystem::u8path(files[failed].name),
+        std::make_error_code(std::errc::io_error));
+  }
+}
+
+}  // namespace saptapper
@@ -0,0 +1,64 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_BATCH_FILE_WRITER_HPP_
+#define SAPTAPPER_BATCH_FILE_WRITER_HPP_
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace saptapper {
+
+/// Writes many files under a directory at once, each with a single write.
+///
+/// On Linux the files are unlinked, opened, written and closed through
+/// io_uring, relative to a descriptor of the directory, so that a batch
+/// costs a few system calls rather than several per file. Where io_uring is
+/// not available, a few threads write the files instead.
+class BatchFileWriter {
+ public:
+  struct File {
+    /// The path relative to the directory, in UTF-8 with '/' separators.
+    std::string name;
+    std::string data;
+  };
+
+  /// With use_io_uring false, the files are always written by threads.
+  explicit BatchFileWriter(std::filesystem::path directory,
+                           bool use_io_uring = true);
+  ~BatchFileWriter();
+
+  BatchFileWriter(const BatchFileWriter&) = delete;
+  BatchFileWriter& operator=(const BatchFileWriter&) = delete;
+
+  const std::filesystem::path& directory() const noexcept {
+    return directory_;
+  }
+
+  /// Whether the last batch went through io_uring.
+  bool uses_io_uring() const noexcept { return uring_ != nullptr; }
+
+  /// Replaces the files. The directories of the files must exist already.
+  /// An existing file is removed rather than truncated, as it may be a hard
+  /// link. Every file is attempted, and then the first failure is thrown as
+  /// std::filesystem::filesystem_error.
+  void Write(const std::vector<File>& files);
+
+ private:
+  class Uring;
+
+  static constexpr unsigned int kMaximumThreads = 8;
+
+  std::filesystem::path directory_;
+  bool use_io_uring_;
+  bool uring_checked_ = false;
+  std::unique_ptr<Uring> uring_;
+
+  void WriteWithThreads(const std::vector<File>& files) const;
+};
+
+}  // namespace saptapper
+
+#endif
@@ -0,0 +1,332 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "batch_ripper.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bounded_queue.hpp"
+#include "cartridge.hpp"
+#include "inspection_cache.hpp"
+#include "minigsf_driver_param.hpp"
+#include "mp2k_driver_param.hpp"
+#include "output_sink.hpp"
+#include "saptapper.hpp"
+#include "types.hpp"
+
+namespace saptapper {
+
+namespace {
+
+// Caps the number of ROM images held at once. The images it loads give their
+// place back when they are destroyed.
+class CartridgeBudget {
+ public:
+  struct Deleter {
+    CartridgeBudget* budget;
+
+    void operator()(Cartridge* cartridge) const {
+      delete cartridge;
+      budget->Release();
+    }
+  };
+
+  using CartridgePtr = std::unique_ptr<Cartridge, Deleter>;
+
+  explicit CartridgeBudget(std::size_t limit) : limit_{limit} {}
+
+  // Loads and prefetches the ROM, waiting while the budget is used up.
+  CartridgePtr Load(const std::filesystem::path& path) {
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      released_.wait(lock, [&] { return held_ < limit_; });
+      held_++;
+    }
+
+    try {
+      auto cartridge =
+          std::make_unique<Cartridge>(Cartridge::LoadFromFile(path));
+      cartridge->Prefetch();
+      return CartridgePtr{cartridge.release(), Deleter{this}};
+    } catch (...) {
+      Release();
+      throw;
+    }
+  }
+
+ private:
+  std::size_t limit_;
+  std::size_t held_ = 0;
+  std::mutex mutex_;
+  std::condition_variable released_;
+
+  void Release() {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      held_--;
+    }
+    released_.notify_one();
+  }
+};
+
+// A ROM on its way through the stages.
+struct Job {
+  std::size_t index = 0;
+  std::filesystem::path base_path;
+  CartridgeBudget::CartridgePtr cartridge{nullptr, {nullptr}};
+  Mp2kDriverParam param;
+  MinigsfDriverParam minigsf;
+  agbptr_t gsf_driver_addr = agbnullptr;
+  // The files of the set, kept by the compression stage for the writer
+  // stage. Copied files are kept by path, so that the writer can still link
+  // them.
+  MemoryOutputSink set{true};
+  BatchRipper::Result result;
+};
+
+}  // namespace
+
+std::vector<BatchRipper::Result> BatchRipper::Run(
+    const std::vector<std::filesystem::path>& roms,
+    std::ostream& progress) const {
+  const std::vector<std::filesystem::path> basenames{
+      MakeUniqueBasenames(roms)};
+  std::vector<Result> results(roms.size());
+  if (roms.empty()) return results;
+
+  const unsigned int cpus = std::max(1u, std::thread::hardware_concurrency());
+  unsigned int jobs = jobs_ != 0 ? jobs_ : cpus;
+  jobs = static_cast<unsigned int>(std::min<std::size_t>(jobs, roms.size()));
+  const auto readers = static_cast<unsigned int>(
+      std::min<std::size_t>(kReaderThreads, roms.size()));
+
+  ConvertOptions options{options_};
+  if (options.compression_threads() == 0)
+    options.set_compression_threads(std::max(1u, cpus / jobs));
+
+  CartridgeBudget budget{max_cartridges_ != 0 ? max_cartridges_
+                                              : jobs * 2 + readers};
+  BoundedQueue<std::unique_ptr<Job>> analysis_queue{jobs};
+  BoundedQueue<std::unique_ptr<Job>> compression_queue{jobs};
+  BoundedQueue<std::unique_ptr<Job>> write_queue{kWriterThreads * 2};
+
+  std::mutex progress_mutex;
+  std::size_t done = 0;
+  auto finish = [&](Job& job) {
+    job.cartridge.reset();
+
+    std::lock_guard<std::mutex> lock{progress_mutex};
+    Result& result = job.result;
+    progress << "[" << ++done << "/" << roms.size() << "] "
+             << result.rom_path.string() << ": ";
+    if (result.ok) {
+      progress << "OK (" << result.song_count << " songs)" << std::endl;
+    } else {
+      progress << "FAILED" << std::endl;
+    }
+    results[job.index] = std::move(result);
+  };
+
+  std::atomic<std::size_t> next_index{0};
+  auto load = [&]() {
+    for (;;) {
+      const std::size_t index = next_index++;
+      if (index >= roms.size()) return;
+
+      auto job = std::make_unique<Job>();
+      job->index = index;
+      job->result.rom_path = roms[index];
+      job->result.outdir = outdir_ / basenames[index];
+      job->base_path = job->result.outdir / basenames[index];
+      try {
+        job->cartridge = budget.Load(roms[index]);
+      } catch (std::exception& e) {
+        job->result.message = e.what();
+        finish(*job);
+        continue;
+      }
+      analysis_queue.Push(std::move(job));
+    }
+  };
+
+  auto analyze = [&]() {
+    std::unique_ptr<Job> job;
+    while (analysis_queue.Pop(job)) {
+      try {
+        Saptapper::Inspect(*job->cartridge,
+                           InspectionCache{options.cache_dir()}, job->param,
+                           job->minigsf, job->gsf_driver_addr,
+                           !inspect_only_);
+      } catch (std::exception& e) {
+        job->result.message = e.what();
+        finish(*job);
+        continue;
+      }
+
+      if (inspect_only_) {
+        std::ostringstream report;
+        Saptapper::PrintParam(report, job->param, job->minigsf);
+        job->result.report = report.str();
+        job->result.song_count = job->param.song_count();
+        job->result.ok = job->param.ok();
+        if (!job->result.ok)
+          job->result.message =
+              "Identification of MusicPlayer2000 driver is incomplete.";
+        finish(*job);
+        continue;
+      }
+      compression_queue.Push(std::move(job));
+    }
+  };
+
+  auto compress = [&]() {
+    std::unique_ptr<Job> job;
+    while (compression_queue.Pop(job)) {
+      try {
+        job->result.song_count = Saptapper::SaveGsfSet(
+            *job->cartridge, job->param, job->minigsf, job->gsf_driver_addr,
+            job->base_path.filename(), job->set, options);
+      } catch (std::exception& e) {
+        job->result.message = e.what();
+        finish(*job);
+        continue;
+      }
+      job->cartridge.reset();
+      write_queue.Push(std::move(job));
+    }
+  };
+
+  auto write = [&]() {
+    std::unique_ptr<Job> job;
+    while (write_queue.Pop(job)) {
+      try {
+        const std::unique_ptr<OutputSink> sink{
+            Saptapper::NewOutputSink(job->base_path, options)};
+        job->set.WriteTo(*sink);
+        sink->Close();
+        job->result.ok = true;
+      } catch (std::exception& e) {
+        job->result.message = e.what();
+      }
+      finish(*job);
+    }
+  };
+
+  // Each queue is closed once the stage that fills it is done.
+  const auto start = [](auto& stage, unsigned int count) {
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < count; i++) threads.emplace_back(stage);
+    return threads;
+  };
+  const auto join = [](std::vector<std::thread>& threads) {
+    for (auto& thread : threads) thread.join();
+  };
+  const unsigned int writers = inspect_only_ ? 0 : kWriterThreads;
+  auto loaders = start(load, readers);
+  auto analyzers = start(analyze, jobs);
+  auto compressors = start(compress, inspect_only_ ? 0 : jobs);
+  auto savers = start(write, writers);
+  join(loaders);
+  analysis_queue.Close();
+  join(analyzers);
+  compression_queue.Close();
+  join(compressors);
+  write_queue.Close();
+  join(savers);
+
+  return results;
+}
+
+std::ostream& BatchRipper::WriteSummary(std::ostream& stream,
+                                        const std::vector<Result>& results) {
+  const auto succeeded = std::count_if(
+      results.begin(), results.end(),
+      [](const Result& result) { return result.ok; });
+  stream << results.size() << " ROM(s) processed: " << succeeded
+         << " succeeded, " << (results.size() - succeeded) << " failed."
+         << std::endl;
+
+  for (const auto& result : results) {
+    if (result.ok) continue;
+    stream << std::endl << result.rom_path.string() << ":" << std::endl;
+    stream << result.message << std::endl;
+  }
+  return stream;
+}
+
+std::vector<std::filesystem::path> BatchRipper::CollectRomFiles(
+    const std::vector<std::filesystem::path>& inputs) {
+  std::vector<std::filesystem::path> roms;
+  for (const auto& input : inputs) {
+    if (!is_directory(input)) {
+      roms.push_back(input);
+      continue;
+    }
+
+    std::vector<std::filesystem::path> found;
+    for (const auto& entry :
+         std::filesystem::recursive_directory_iterator(input)) {
+      if (entry.is_regular_file() && IsRomFile(entry.path()))
+        found.push_back(entry.path());
+    }
+    std::sort(found.begin(), found.end());
+    roms.insert(roms.end(), found.begin(), found.end());
+  }
+  return roms;
+}
+
+std::vector<std::filesystem::path> BatchRipper::ReadListFile(
+    const std::filesystem::path& path) {
+  std::ifstream stream(path);
+  if (!stream) {
+    throw std::runtime_error(path.string() + ": Unable to open the list file");
+  }
+
+  std::vector<std::filesystem::path> paths;
+  std::string line;
+  while (std::getline(stream, line)) {
+    while (!line.empty() &&
+           std::isspace(static_cast<unsigned char>(line.back())))
+      line.pop_back();
+    if (line.empty() || line[0] == '#') continue;
+    paths.emplace_back(line);
+  }
+  return paths;
+}
+
+bool BatchRipper::IsRomFile(const std::filesystem::path& path) {
+  std::string extension{path.extension().string()};
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return extension == ".gba" || extension == ".agb" || extension == ".bin";
+}
+
+std::vector<std::filesystem::path> BatchRipper::MakeUniqueBasenames(
+    const std::vector<std::filesystem::path>& roms) {
+  std::vector<std::filesystem::path> basenames;
+  std::map<std::string, int> used;
+  for (const auto& rom : roms) {
+    const std::string stem{rom.stem().string()};
+    std::string basename{stem};
+    for (int suffix = 2; used.count(basename) != 0; suffix++)
+      basename = stem + "-" + std::to_string(suffix);
+    used[basename]++;
+    basenames.emplace_back(basename);
+  }
+  return basenames;
+}
+
+}  // namespace saptapper
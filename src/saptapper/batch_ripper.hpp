@@ -0,0 +1,87 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_BATCH_RIPPER_HPP_
+#define SAPTAPPER_BATCH_RIPPER_HPP_
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "convert_options.hpp"
+
+namespace saptapper {
+
+class BatchRipper {
+ public:
+  struct Result {
+    std::filesystem::path rom_path;
+    std::filesystem::path outdir;
+    bool ok = false;
+    int song_count = 0;
+    std::string message;
+    std::string report;
+  };
+
+  BatchRipper() = default;
+
+  unsigned int jobs() const noexcept { return jobs_; }
+
+  /// The most ROM images held in memory at once (0 means twice the number of
+  /// jobs, plus 2).
+  unsigned int max_cartridges() const noexcept { return max_cartridges_; }
+
+  bool inspect_only() const noexcept { return inspect_only_; }
+  const std::filesystem::path& outdir() const noexcept { return outdir_; }
+  const ConvertOptions& options() const noexcept { return options_; }
+
+  void set_jobs(unsigned int jobs) noexcept { jobs_ = jobs; }
+  void set_max_cartridges(unsigned int max_cartridges) noexcept {
+    max_cartridges_ = max_cartridges;
+  }
+  void set_inspect_only(bool inspect_only) noexcept {
+    inspect_only_ = inspect_only;
+  }
+  void set_outdir(std::filesystem::path outdir) {
+    outdir_ = std::move(outdir);
+  }
+  void set_options(ConvertOptions options) { options_ = std::move(options); }
+
+  // Processes every ROM in a pipeline of stages connected by bounded queues:
+  // a few readers load the ROMs ahead, jobs() workers inspect them, jobs()
+  // workers compress the sets in memory, and a few writers save them. Each
+  // ROM is ripped into its own subdirectory of outdir() named after the ROM
+  // file. Unless set in the options, the CPUs are shared out between the
+  // compression workers.
+  std::vector<Result> Run(const std::vector<std::filesystem::path>& roms,
+                          std::ostream& progress = std::cerr) const;
+
+  static std::ostream& WriteSummary(std::ostream& stream,
+                                    const std::vector<Result>& results);
+
+  // Expands directories (recursively) into the ROM files they contain.
+  static std::vector<std::filesystem::path> CollectRomFiles(
+      const std::vector<std::filesystem::path>& inputs);
+
+  // Reads a list of ROM paths, one per line. Empty lines and lines starting
+  // with '#' are ignored.
+  static std::vector<std::filesystem::path> ReadListFile(
+      const std::filesystem::path& path);
+
+ private:
+  static constexpr unsigned int kReaderThreads = 2;
+  static constexpr unsigned int kWriterThreads = 2;
+
+  unsigned int jobs_ = 0;
+  unsigned int max_cartridges_ = 0;
+  bool inspect_only_ = false;
+  std::filesystem::path outdir_;
+  ConvertOptions options_;
+
+  static bool IsRomFile(const std::filesystem::path& path);
+  static std::vector<std::filesystem::path> MakeUniqueBasenames(
+      const std::vector<std::filesystem::path>& roms);
+};
+
+}  // namespace saptapper
+
+#endif
@@ -0,0 +1,74 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_BOUNDED_QUEUE_HPP_
+#define SAPTAPPER_BOUNDED_QUEUE_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace saptapper {
+
+/// A first-in first-out queue between threads that holds at most capacity
+/// items. Push waits while the queue is full and Pop while it is empty, so
+/// a fast producer is held back to the pace of its consumers.
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(std::size_t capacity)
+      : capacity_{capacity != 0 ? capacity : 1} {}
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  std::size_t capacity() const noexcept { return capacity_; }
+
+  /// Adds the item, waiting for room. Returns false (and drops the item) if
+  /// the queue is closed.
+  bool Push(T item) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    not_full_.wait(lock,
+                   [&] { return closed_ || items_.size() < capacity_; });
+    if (closed_) return false;
+
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /// Takes the oldest item, waiting for one. Returns false once the queue is
+  /// closed and empty.
+  bool Pop(T& item) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+    if (items_.empty()) return false;
+
+    item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  /// Ends the queue: nothing more is pushed, and Pop returns false once the
+  /// items left are taken.
+  void Close() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+ private:
+  std::size_t capacity_;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::deque<T> items_;
+  bool closed_ = false;
+};
+
+}  // namespace saptapper
+
+#endif
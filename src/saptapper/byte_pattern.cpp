@@ -2,27 +2,118 @@
 
 #include "byte_pattern.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <string_view>
 
 namespace saptapper {
 
 bool BytePattern::Match(std::string_view data, size_type pos) const {
-  if (data.size() < pos + size()) return false;
+  if (pos > data.size() || data.size() - pos < size()) return false;
 
-  for (size_type offset = 0; offset < size(); offset++) {
-    if (!mask_.empty() && mask_[offset] == '?') continue;
-    if (data[pos + offset] != data_[offset]) return false;
+  const char* p = data.data() + pos;
+  for (const Chunk& chunk : chunks_) {
+    if ((Load(p + chunk.offset, chunk_width_) & chunk.mask) != chunk.data)
+      return false;
   }
   return true;
 }
 
 BytePattern::size_type BytePattern::Find(std::string_view data,
                                          size_type pos) const {
-  for (size_type offset = pos; offset <= data.size() - size(); offset++) {
-    if (Match(data, offset)) return offset;
+  if (pos > data.size() || data.size() - pos < size())
+    return std::string::npos;
+
+  const size_type last = data.size() - size();
+  if (anchor_size_ == 0) return pos;
+
+  while (pos <= last) {
+    const size_type found = FindAnchor(data, pos, last);
+    if (found == std::string::npos) break;
+    if (Match(data, found)) return found;
+    pos = found + 1;
+  }
+  return std::string::npos;
+}
+
+void BytePattern::Compile() {
+  // Find the longest run of checked bytes.
+  for (size_type offset = 0; offset < size();) {
+    if (!IsChecked(offset)) {
+      offset++;
+      continue;
+    }
+    size_type end = offset;
+    while (end < size() && IsChecked(end)) end++;
+    if (end - offset > anchor_size_) {
+      anchor_offset_ = offset;
+      anchor_size_ = end - offset;
+    }
+    offset = end;
+  }
+
+  skip_.fill(anchor_size_);
+  for (size_type i = 0; i + 1 < anchor_size_; i++) {
+    const auto c = static_cast<unsigned char>(data_[anchor_offset_ + i]);
+    skip_[c] = anchor_size_ - 1 - i;
+  }
+
+  // Cover the pattern with words, the last of which may overlap the previous
+  // one. Words that contain no checked bytes are left out.
+  chunk_width_ = size() >= 8 ? 8 : (size() >= 4 ? 4 : 1);
+  std::string bits(size(), '\0');
+  for (size_type offset = 0; offset < size(); offset++) {
+    if (IsChecked(offset)) bits[offset] = '\xff';
+  }
+  for (size_type offset = 0; offset < size(); offset += chunk_width_) {
+    const size_type start = std::min(offset, size() - chunk_width_);
+    const std::uint64_t mask = Load(&bits[start], chunk_width_);
+    if (mask == 0) continue;
+    chunks_.push_back(
+        {start, Load(&data_[start], chunk_width_) & mask, mask});
+  }
+}
+
+BytePattern::size_type BytePattern::FindAnchor(std::string_view data,
+                                               size_type pos,
+                                               size_type last) const {
+  const char* anchor = data_.data() + anchor_offset_;
+  const char* begin = data.data() + pos + anchor_offset_;
+  const char* end = data.data() + last + anchor_offset_ + anchor_size_;
+
+  if (anchor_size_ == 1) {
+    const void* found = std::memchr(begin, anchor[0], end - begin);
+    if (found == nullptr) return std::string::npos;
+    return static_cast<const char*>(found) - data.data() - anchor_offset_;
+  }
+
+  const char anchor_last = anchor[anchor_size_ - 1];
+  for (const char* p = begin; p + anchor_size_ <= end;) {
+    const char c = p[anchor_size_ - 1];
+    if (c == anchor_last &&
+        std::memcmp(p, anchor, anchor_size_ - 1) == 0) {
+      return p - data.data() - anchor_offset_;
+    }
+    p += skip_[static_cast<unsigned char>(c)];
   }
   return std::string::npos;
 }
 
+std::uint64_t BytePattern::Load(const char* p, size_type width) noexcept {
+  // Pattern words and data words are loaded the same way, so the byte order
+  // does not matter.
+  if (width == 8) {
+    std::uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+  } else if (width == 4) {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+  }
+  return static_cast<unsigned char>(*p);
+}
+
 }  // namespace saptapper
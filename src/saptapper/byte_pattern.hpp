@@ -6,9 +6,12 @@
 #ifndef SAPTAPPER_BYTE_PATTERN_
 #define SAPTAPPER_BYTE_PATTERN_
 
+#include <array>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace saptapper {
 
@@ -17,7 +20,7 @@ class BytePattern
 public:
   using size_type = std::string::size_type;
 
-  BytePattern(std::string_view data) : data_(data) {}
+  BytePattern(std::string_view data) : data_(data) { Compile(); }
 
   BytePattern(std::string_view data, std::string_view mask)
       : data_(data), mask_(mask) {
@@ -25,6 +28,7 @@ public:
       throw std::invalid_argument(
           "BytePattern: data and mask must be the same size");
     }
+    Compile();
   }
 
   size_type size() const noexcept { return data_.size(); }
@@ -34,6 +38,13 @@ public:
   size_type Find(std::string_view data, size_type pos = 0) const;
 
 private:
+  /// A run of pattern bytes compared as a single word.
+  struct Chunk {
+    size_type offset;
+    std::uint64_t data;
+    std::uint64_t mask;
+  };
+
   /// The pattern to scan for.
   std::string data_;
 
@@ -44,6 +55,28 @@ private:
   /// Example: "xxx????xx" - The first 3 bytes are checked, then the next 4 are ignored,
   /// then the last 2 are checked
   std::string mask_;
+
+  /// The checked bytes of the pattern, chunk_width_ bytes at a time.
+  std::vector<Chunk> chunks_;
+  size_type chunk_width_ = 0;
+
+  /// The longest run of checked bytes, which Find looks for first.
+  size_type anchor_offset_ = 0;
+  size_type anchor_size_ = 0;
+
+  /// Horspool shift for each byte value, relative to the end of the anchor.
+  std::array<size_type, 256> skip_{};
+
+  void Compile();
+
+  bool IsChecked(size_type offset) const noexcept {
+    return mask_.empty() || mask_[offset] != '?';
+  }
+
+  size_type FindAnchor(std::string_view data, size_type pos,
+                       size_type last) const;
+
+  static std::uint64_t Load(const char* p, size_type width) noexcept;
 };
 
 } // namespace saptapper
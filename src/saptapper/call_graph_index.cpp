@@ -0,0 +1,144 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "call_graph_index.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "arm.hpp"
+#include "bytes.hpp"
+#include "cpu_features.hpp"
+#include "types.hpp"
+
+#ifdef SAPTAPPER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace saptapper {
+
+namespace {
+
+// Returns the first even position from pos that holds a Thumb BL pair ending
+// before end, or else the first even position whose pair would not fit.
+// pos must be even.
+std::size_t FindThumbBl(std::string_view rom, std::size_t pos,
+                        std::size_t end) {
+#ifdef SAPTAPPER_SSE2
+  const __m128i mask = _mm_set1_epi16(static_cast<short>(0xf800));
+  const __m128i high = _mm_set1_epi16(static_cast<short>(0xf000));
+  const __m128i low = _mm_set1_epi16(static_cast<short>(0xf800));
+  while (pos + 18 <= end) {
+    const __m128i first =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rom.data() + pos));
+    const __m128i second = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(rom.data() + pos + 2));
+    const __m128i pairs =
+        _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(first, mask), high),
+                      _mm_cmpeq_epi16(_mm_and_si128(second, mask), low));
+    const auto found =
+        static_cast<std::uint32_t>(_mm_movemask_epi8(pairs));
+    if (found != 0) return pos + count_trailing_zeros(found);
+    pos += 16;
+  }
+#endif
+  for (; pos + 4 <= end; pos += 2) {
+    if (is_thumb_bl_high(ReadInt16L(&rom[pos])) &&
+        is_thumb_bl_low(ReadInt16L(&rom[pos + 2])))
+      return pos;
+  }
+  return pos;
+}
+
+// Returns the first word position from pos that holds an ARM B or BL ending
+// before end, or else the first word position that would not fit. pos must
+// be a multiple of 4.
+std::size_t FindArmBranch(std::string_view rom, std::size_t pos,
+                          std::size_t end) {
+#ifdef SAPTAPPER_SSE2
+  // B is 0xEA and BL is 0xEB in the top byte.
+  const __m128i mask = _mm_set1_epi32(static_cast<int>(0xfe000000));
+  const __m128i branch = _mm_set1_epi32(static_cast<int>(0xea000000));
+  while (pos + 16 <= end) {
+    const __m128i words =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rom.data() + pos));
+    const auto found = static_cast<std::uint32_t>(_mm_movemask_ps(
+        _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(words, mask), branch))));
+    if (found != 0) return pos + 4 * count_trailing_zeros(found);
+    pos += 16;
+  }
+#endif
+  for (; pos + 4 <= end; pos += 4) {
+    const armins_t ins = ReadInt32L(&rom[pos]);
+    if (is_arm_b(ins) || is_arm_bl(ins)) return pos;
+  }
+  return pos;
+}
+
+}  // namespace
+
+void CallGraphIndex::Builder::Feed(std::string_view rom, std::size_t end) {
+  end = std::min(end, rom.size());
+  target_bits_.resize((rom.size() / 2 + 31) / 32);
+
+  // Thumb BL pairs, which take four bytes from an even position.
+  std::size_t pos = cursor_;
+  for (;;) {
+    pos = FindThumbBl(rom, pos, end);
+    if (pos + 4 > end) break;
+
+    const thumbins_t high = ReadInt16L(&rom[pos]);
+    const thumbins_t low = ReadInt16L(&rom[pos + 2]);
+    Record(rom, pos, thumb_bl_dest(to_romptr(pos), high, low));
+    pos += 2;
+  }
+  cursor_ = pos;
+
+  // ARM B and BL, at every word.
+  for (;;) {
+    arm_cursor_ = FindArmBranch(rom, arm_cursor_, end);
+    if (arm_cursor_ + 4 > end) break;
+
+    const armins_t ins = ReadInt32L(&rom[arm_cursor_]);
+    Record(rom, arm_cursor_, arm_b_dest(to_romptr(arm_cursor_), ins));
+    arm_cursor_ += 4;
+  }
+}
+
+void CallGraphIndex::Builder::Record(std::string_view rom, std::size_t caller,
+                                     agbptr_t target) {
+  if (!is_romptr(target) || to_offset(target) >= rom.size()) return;
+
+  const std::size_t halfword = to_offset(target) / 2;
+  target_bits_[halfword / 32] |= std::uint32_t{1} << (halfword % 32);
+  calls_.push_back((static_cast<std::uint64_t>(to_offset(target)) << 32) |
+                   caller);
+}
+
+CallGraphIndex CallGraphIndex::Builder::Finish(std::string_view rom) {
+  Feed(rom, rom.size());
+
+  CallGraphIndex index;
+  index.target_bits_ = std::move(target_bits_);
+  index.calls_ = std::move(calls_);
+  std::sort(index.calls_.begin(), index.calls_.end());
+  return index;
+}
+
+CallGraphIndex CallGraphIndex::Build(std::string_view rom) {
+  Builder builder;
+  return builder.Finish(rom);
+}
+
+std::vector<agbsize_t> CallGraphIndex::FindCallers(agbsize_t target) const {
+  const std::uint64_t first = static_cast<std::uint64_t>(target) << 32;
+  std::vector<agbsize_t> callers;
+  for (auto it = std::lower_bound(calls_.begin(), calls_.end(), first);
+       it != calls_.end() && (*it >> 32) == target; ++it) {
+    callers.push_back(static_cast<agbsize_t>(*it));
+  }
+  return callers;
+}
+
+}  // namespace saptapper
@@ -0,0 +1,65 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_CALL_GRAPH_INDEX_HPP_
+#define SAPTAPPER_CALL_GRAPH_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+
+namespace saptapper {
+
+/// Index of the direct calls in a ROM image: Thumb BL pairs at every
+/// halfword and unconditional ARM B/BL at every word, whose destinations
+/// lie inside the image.
+///
+/// Data that happens to decode as a call is recorded as well, so a call
+/// target is a plausible function entry rather than a certain one.
+class CallGraphIndex {
+ public:
+  /// Records the calls while a ROM image is streamed through it in order.
+  class Builder {
+   public:
+    Builder() = default;
+
+    /// Advances through the instructions of the ROM that end before end.
+    void Feed(std::string_view rom, std::size_t end);
+
+    CallGraphIndex Finish(std::string_view rom);
+
+   private:
+    std::vector<std::uint32_t> target_bits_;
+    std::vector<std::uint64_t> calls_;
+    std::size_t cursor_ = 0;
+    std::size_t arm_cursor_ = 0;
+
+    void Record(std::string_view rom, std::size_t caller, agbptr_t target);
+  };
+
+  CallGraphIndex() = default;
+
+  static CallGraphIndex Build(std::string_view rom);
+
+  /// Whether any call lands on the given offset of the image.
+  bool IsCallTarget(agbsize_t offset) const noexcept {
+    if (offset % 2 != 0) return false;
+    const std::size_t halfword = offset / 2;
+    return halfword / 32 < target_bits_.size() &&
+           ((target_bits_[halfword / 32] >> (halfword % 32)) & 1);
+  }
+
+  /// The offsets of the calls to the given offset, in ascending order.
+  std::vector<agbsize_t> FindCallers(agbsize_t target) const;
+
+ private:
+  std::vector<std::uint32_t> target_bits_;
+
+  /// The calls, as (target << 32 | caller) in ascending order.
+  std::vector<std::uint64_t> calls_;
+};
+
+}  // namespace saptapper
+
+#endif
@@ -2,20 +2,98 @@
 
 #include "cartridge.hpp"
 
+#include <cstddef>
 #include <filesystem>
 #include <fstream>
 #include <stdexcept>
 #include <string>
 #include <utility>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace saptapper {
 
+Cartridge& Cartridge::operator=(Cartridge&& other) noexcept {
+  if (this == &other) return *this;
+
+  Release();
+  const bool buffered = other.mapping_ == nullptr && other.data_ != nullptr;
+  buffer_ = std::move(other.buffer_);
+  mapping_ = std::exchange(other.mapping_, nullptr);
+  mapping_size_ = std::exchange(other.mapping_size_, 0);
+  size_ = std::exchange(other.size_, 0);
+  data_ = buffered ? buffer_.data() : other.data_;
+  other.data_ = nullptr;
+  return *this;
+}
+
 Cartridge Cartridge::LoadFromFile(const std::filesystem::path& path) {
   Cartridge cartridge;
 
   const auto size = file_size(path);
   ValidateSize(size);
 
+  if (!cartridge.MapFile(path, size)) cartridge.ReadFile(path, size);
+  return cartridge;
+}
+
+void Cartridge::Prefetch() const noexcept {
+  if (mapping_ == nullptr) return;
+
+#ifndef _WIN32
+  madvise(mapping_, mapping_size_, MADV_WILLNEED);
+#endif
+  // Touch a byte of every page.
+  constexpr std::size_t kPageSize = 4096;
+  volatile char sink = 0;
+  for (std::size_t offset = 0; offset < size_; offset += kPageSize)
+    sink = static_cast<char>(sink ^ data_[offset]);
+  (void)sink;
+}
+
+bool Cartridge::MapFile(const std::filesystem::path& path,
+                        std::uintmax_t size) {
+  // The padding up to a multiple of 4 always lies in the last page of the
+  // file, which the system fills with zeros.
+  const auto aligned_size = static_cast<size_type>((size + 3) & ~3);
+
+#ifdef _WIN32
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  HANDLE mapping =
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr) return false;
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (view == nullptr) return false;
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) return false;
+  void* view = mmap(nullptr, aligned_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (view == MAP_FAILED) return false;
+#endif
+
+  mapping_ = view;
+  mapping_size_ = aligned_size;
+  data_ = static_cast<const char*>(view);
+  size_ = aligned_size;
+  return true;
+}
+
+void Cartridge::ReadFile(const std::filesystem::path& path,
+                         std::uintmax_t size) {
   std::ifstream stream(path, std::ios::in | std::ios::binary);
   stream.exceptions(std::ios::badbit | std::ios::eofbit | std::ios::failbit);
 
@@ -24,8 +102,24 @@ Cartridge Cartridge::LoadFromFile(const std::filesystem::path& path) {
   stream.read(rom.data(), size);
   stream.close();
 
-  cartridge.rom_ = std::move(rom);
-  return cartridge;
+  buffer_ = std::move(rom);
+  data_ = buffer_.data();
+  size_ = static_cast<size_type>(buffer_.size());
+}
+
+void Cartridge::Release() noexcept {
+  if (mapping_ != nullptr) {
+#ifdef _WIN32
+    UnmapViewOfFile(mapping_);
+#else
+    munmap(mapping_, mapping_size_);
+#endif
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+  }
+  std::string().swap(buffer_);
+  data_ = nullptr;
+  size_ = 0;
 }
 
 void Cartridge::ValidateSize(std::uintmax_t size) {
@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include "types.hpp"
 
 namespace saptapper {
@@ -18,17 +19,43 @@ class Cartridge {
   static constexpr agbsize_t kMaximumSize = 0x2000000;
 
   Cartridge() = default;
+  Cartridge(const Cartridge&) = delete;
+  Cartridge& operator=(const Cartridge&) = delete;
+  Cartridge(Cartridge&& other) noexcept { *this = std::move(other); }
+  Cartridge& operator=(Cartridge&& other) noexcept;
+  ~Cartridge() { Release(); }
 
-  std::string& rom() { return rom_; }
-  const std::string& rom() const { return rom_; }
-  size_type size() const { return static_cast<agbsize_t>(rom_.size()); }
-  std::string game_title() const { return rom_.substr(0xa0, 12); }
-  std::string game_code() const { return rom_.substr(0xac, 4); }
+  std::string_view rom() const { return std::string_view{data_, size_}; }
+  const char* data() const { return data_; }
+  size_type size() const { return size_; }
+  std::string game_title() const { return std::string{rom().substr(0xa0, 12)}; }
+  std::string game_code() const { return std::string{rom().substr(0xac, 4)}; }
 
+  /// Loads a ROM file, padded with zeros to a multiple of 4 bytes.
+  ///
+  /// The file is mapped read-only where the platform allows it, so only the
+  /// pages that are read get loaded and the image can be shared between
+  /// threads. Patches are applied with PatchedRomView.
   static Cartridge LoadFromFile(const std::filesystem::path& path);
 
+  /// Reads the whole mapped image in now, so that later reads do not wait
+  /// for the disk.
+  void Prefetch() const noexcept;
+
  private:
-  std::string rom_;
+  const char* data_ = nullptr;
+  size_type size_ = 0;
+
+  /// The mapped region (null unless the ROM is memory-mapped).
+  void* mapping_ = nullptr;
+  std::size_t mapping_size_ = 0;
+
+  /// Fallback storage when the file cannot be mapped.
+  std::string buffer_;
+
+  bool MapFile(const std::filesystem::path& path, std::uintmax_t size);
+  void ReadFile(const std::filesystem::path& path, std::uintmax_t size);
+  void Release() noexcept;
 
   static void ValidateSize(std::uintmax_t size);
 };
@@ -0,0 +1,124 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "content_hash.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace saptapper {
+
+namespace {
+
+constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+constexpr std::uint64_t RotateLeft(std::uint64_t value, int count) {
+  return (value << count) | (value >> (64 - count));
+}
+
+std::uint64_t Read64(const char* p) {
+  std::uint64_t value = 0;
+  for (int i = 7; i >= 0; i--)
+    value = (value << 8) | static_cast<unsigned char>(p[i]);
+  return value;
+}
+
+std::uint32_t Read32(const char* p) {
+  std::uint32_t value = 0;
+  for (int i = 3; i >= 0; i--)
+    value = (value << 8) | static_cast<unsigned char>(p[i]);
+  return value;
+}
+
+constexpr std::uint64_t Round(std::uint64_t lane, std::uint64_t input) {
+  return RotateLeft(lane + input * kPrime2, 31) * kPrime1;
+}
+
+constexpr std::uint64_t MergeRound(std::uint64_t hash, std::uint64_t lane) {
+  return (hash ^ Round(0, lane)) * kPrime1 + kPrime4;
+}
+
+}  // namespace
+
+ContentHash::ContentHash() noexcept
+    : lanes_{kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1} {}
+
+void ContentHash::Update(std::string_view data) noexcept {
+  total_size_ += data.size();
+  const char* p = data.data();
+  std::size_t size = data.size();
+
+  if (buffered_ != 0) {
+    const std::size_t count = std::min(size, kStripeSize - buffered_);
+    std::memcpy(&buffer_[buffered_], p, count);
+    buffered_ += count;
+    p += count;
+    size -= count;
+    if (buffered_ < kStripeSize) return;
+    ConsumeStripes(buffer_.data(), 1);
+    buffered_ = 0;
+  }
+
+  const std::size_t stripes = size / kStripeSize;
+  ConsumeStripes(p, stripes);
+  p += stripes * kStripeSize;
+  size -= stripes * kStripeSize;
+
+  std::memcpy(buffer_.data(), p, size);
+  buffered_ = size;
+}
+
+std::uint64_t ContentHash::digest() const noexcept {
+  std::uint64_t hash;
+  if (total_size_ >= kStripeSize) {
+    hash = RotateLeft(lanes_[0], 1) + RotateLeft(lanes_[1], 7) +
+           RotateLeft(lanes_[2], 12) + RotateLeft(lanes_[3], 18);
+    for (const std::uint64_t lane : lanes_) hash = MergeRound(hash, lane);
+  } else {
+    hash = kPrime5;
+  }
+  hash += total_size_;
+
+  const char* p = buffer_.data();
+  std::size_t size = buffered_;
+  for (; size >= 8; p += 8, size -= 8)
+    hash = RotateLeft(hash ^ Round(0, Read64(p)), 27) * kPrime1 + kPrime4;
+  if (size >= 4) {
+    hash = RotateLeft(hash ^ (Read32(p) * kPrime1), 23) * kPrime2 + kPrime3;
+    p += 4;
+    size -= 4;
+  }
+  for (; size != 0; p++, size--) {
+    hash = RotateLeft(hash ^ (static_cast<unsigned char>(*p) * kPrime5), 11) *
+           kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+void ContentHash::ConsumeStripes(const char* data,
+                                 std::size_t count) noexcept {
+  std::uint64_t lane0 = lanes_[0];
+  std::uint64_t lane1 = lanes_[1];
+  std::uint64_t lane2 = lanes_[2];
+  std::uint64_t lane3 = lanes_[3];
+  for (std::size_t i = 0; i < count; i++, data += kStripeSize) {
+    lane0 = Round(lane0, Read64(data));
+    lane1 = Round(lane1, Read64(data + 8));
+    lane2 = Round(lane2, Read64(data + 16));
+    lane3 = Round(lane3, Read64(data + 24));
+  }
+  lanes_ = {lane0, lane1, lane2, lane3};
+}
+
+}  // namespace saptapper
@@ -0,0 +1,45 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_CONTENT_HASH_HPP_
+#define SAPTAPPER_CONTENT_HASH_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace saptapper {
+
+/// Streaming XXH64 hash (seed 0) of a ROM image, used to identify ROMs with
+/// the same contents.
+class ContentHash {
+ public:
+  ContentHash() noexcept;
+
+  /// Hashes the next piece of data.
+  void Update(std::string_view data) noexcept;
+
+  /// The hash of the data so far.
+  std::uint64_t digest() const noexcept;
+
+  /// Hashes data in one call.
+  static std::uint64_t Compute(std::string_view data) noexcept {
+    ContentHash hash;
+    hash.Update(data);
+    return hash.digest();
+  }
+
+ private:
+  static constexpr std::size_t kStripeSize = 32;
+
+  std::array<std::uint64_t, 4> lanes_;
+  std::array<char, kStripeSize> buffer_{};
+  std::size_t buffered_ = 0;
+  std::uint64_t total_size_ = 0;
+
+  void ConsumeStripes(const char* data, std::size_t count) noexcept;
+};
+
+}  // namespace saptapper
+
+#endif
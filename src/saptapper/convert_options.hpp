@@ -0,0 +1,75 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_CONVERT_OPTIONS_HPP_
+#define SAPTAPPER_CONVERT_OPTIONS_HPP_
+
+#include <filesystem>
+#include <string>
+#include <utility>
+
+namespace saptapper {
+
+class ConvertOptions {
+ public:
+  ConvertOptions() = default;
+
+  const std::string& gsfby() const noexcept { return gsfby_; }
+
+  bool keep_duplicated() const noexcept { return keep_duplicated_; }
+
+  bool content_dedup() const noexcept { return content_dedup_; }
+
+  /// Whether the set is saved into a single ZIP archive.
+  bool zip_output() const noexcept { return zip_output_; }
+
+  unsigned int compression_threads() const noexcept {
+    return compression_threads_;
+  }
+
+  /// The directory of the gsflib store (empty to disable it).
+  const std::filesystem::path& gsflib_store() const noexcept {
+    return gsflib_store_;
+  }
+
+  /// The directory of the inspection cache (empty to disable it).
+  const std::filesystem::path& cache_dir() const noexcept {
+    return cache_dir_;
+  }
+
+  void set_gsfby(std::string gsfby) { gsfby_ = std::move(gsfby); }
+
+  void set_keep_duplicated(bool keep_duplicated) noexcept {
+    keep_duplicated_ = keep_duplicated;
+  }
+
+  void set_content_dedup(bool content_dedup) noexcept {
+    content_dedup_ = content_dedup;
+  }
+
+  void set_zip_output(bool zip_output) noexcept { zip_output_ = zip_output; }
+
+  void set_compression_threads(unsigned int threads) noexcept {
+    compression_threads_ = threads;
+  }
+
+  void set_gsflib_store(std::filesystem::path gsflib_store) {
+    gsflib_store_ = std::move(gsflib_store);
+  }
+
+  void set_cache_dir(std::filesystem::path cache_dir) {
+    cache_dir_ = std::move(cache_dir);
+  }
+
+ private:
+  std::string gsfby_;
+  bool keep_duplicated_ = false;
+  bool content_dedup_ = false;
+  bool zip_output_ = false;
+  unsigned int compression_threads_ = 0;
+  std::filesystem::path gsflib_store_;
+  std::filesystem::path cache_dir_;
+};
+
+}  // namespace saptapper
+
+#endif
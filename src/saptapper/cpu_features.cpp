@@ -0,0 +1,46 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "cpu_features.hpp"
+
+#if defined(SAPTAPPER_X86) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace saptapper {
+
+CpuFeatures::CpuFeatures() {
+#if defined(SAPTAPPER_X86) && (defined(__GNUC__) || defined(__clang__))
+  __builtin_cpu_init();
+  avx2_ = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+  avx512bw_ = avx2_ && __builtin_cpu_supports("avx512f") &&
+              __builtin_cpu_supports("avx512bw");
+#elif defined(SAPTAPPER_X86) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  const int max_leaf = info[0];
+  if (max_leaf < 7) return;
+
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool popcnt = (info[2] & (1 << 23)) != 0;
+  if (!osxsave) return;
+
+  // The OS must save the YMM (and ZMM) registers on context switches.
+  const unsigned long long xcr0 = _xgetbv(0);
+  const bool ymm = (xcr0 & 0x06) == 0x06;
+  const bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+  __cpuidex(info, 7, 0);
+  avx2_ = ymm && popcnt && (info[1] & (1 << 5)) != 0;
+  avx512bw_ = avx2_ && zmm && (info[1] & (1 << 16)) != 0 &&
+              (info[1] & (1 << 30)) != 0;
+#endif
+}
+
+const CpuFeatures& CpuFeatures::Get() {
+  static const CpuFeatures features;
+  return features;
+}
+
+}  // namespace saptapper
@@ -0,0 +1,60 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_CPU_FEATURES_HPP_
+#define SAPTAPPER_CPU_FEATURES_HPP_
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define SAPTAPPER_X86 1
+#endif
+
+#if defined(SAPTAPPER_X86) &&                                  \
+    (defined(__SSE2__) || defined(_M_X64) ||                   \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SAPTAPPER_SSE2 1
+#endif
+
+// Enables an instruction set for a single function, so that the kernels can
+// be selected at runtime without compiling the whole program for them.
+#if defined(__GNUC__) || defined(__clang__)
+#define SAPTAPPER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SAPTAPPER_TARGET(isa)
+#endif
+
+namespace saptapper {
+
+/// Instruction set extensions available at runtime.
+class CpuFeatures {
+ public:
+  bool avx2() const noexcept { return avx2_; }
+  bool avx512bw() const noexcept { return avx512bw_; }
+
+  /// The features of the running CPU, detected once.
+  static const CpuFeatures& Get();
+
+ private:
+  bool avx2_ = false;
+  bool avx512bw_ = false;
+
+  CpuFeatures();
+};
+
+inline int count_trailing_zeros(std::uint32_t value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(value);
+#else
+  int count = 0;
+  while ((value & 1) == 0) {
+    value >>= 1;
+    count++;
+  }
+  return count;
+#endif
+}
+
+}  // namespace saptapper
+
+#endif
@@ -0,0 +1,121 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_FIXED_BYTE_PATTERN_HPP_
+#define SAPTAPPER_FIXED_BYTE_PATTERN_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include "bytes.hpp"
+
+namespace saptapper {
+
+/// Byte pattern of a fixed size, parsed and compiled at compile time.
+///
+/// Unlike BytePattern, the pattern is a literal type. A constexpr pattern is
+/// matched by a fixed sequence of masked word compares, which the compiler
+/// folds into constants.
+template <std::size_t Size>
+class FixedBytePattern {
+ public:
+  static_assert(Size != 0, "FixedBytePattern: the pattern must not be empty");
+
+  using size_type = std::size_t;
+
+  /// Parses a list of hex bytes separated by spaces, where "??" matches any
+  /// byte. For example: "00 B5 ?? 48".
+  constexpr explicit FixedBytePattern(const char* text) {
+    for (size_type i = 0; i < Size; i++) {
+      const char* token = text + i * 3;
+      if (i != 0 && token[-1] != ' ')
+        throw std::invalid_argument("FixedBytePattern: missing separator");
+      if (token[0] == '?' && token[1] == '?') continue;
+      data_[i] = static_cast<std::uint8_t>((ParseHexDigit(token[0]) << 4) |
+                                           ParseHexDigit(token[1]));
+      mask_[i] = 0xff;
+    }
+
+    for (size_type i = 0; i < kWordCount; i++) {
+      for (size_type j = 0; j < kWordWidth; j++) {
+        const size_type offset = WordOffset(i) + j;
+        data_words_[i] |= static_cast<std::uint32_t>(data_[offset]) << (8 * j);
+        mask_words_[i] |= static_cast<std::uint32_t>(mask_[offset]) << (8 * j);
+      }
+    }
+  }
+
+  static constexpr size_type size() noexcept { return Size; }
+
+  constexpr std::uint8_t data(size_type index) const { return data_[index]; }
+
+  constexpr bool is_fixed(size_type index) const {
+    return mask_[index] != 0;
+  }
+
+  constexpr bool Match(std::string_view data, size_type pos = 0) const {
+    if (pos > data.size() || data.size() - pos < Size) return false;
+    return MatchWords(data.data() + pos,
+                      std::make_index_sequence<kWordCount>{});
+  }
+
+ private:
+  // The pattern is covered by words, the last of which may overlap the
+  // previous one.
+  static constexpr size_type kWordWidth = Size >= 4 ? 4 : Size;
+  static constexpr size_type kWordCount =
+      (Size + kWordWidth - 1) / kWordWidth;
+
+  std::array<std::uint8_t, Size> data_{};
+  std::array<std::uint8_t, Size> mask_{};
+  std::array<std::uint32_t, kWordCount> data_words_{};
+  std::array<std::uint32_t, kWordCount> mask_words_{};
+
+  static constexpr size_type WordOffset(size_type index) noexcept {
+    return index * kWordWidth < Size - kWordWidth ? index * kWordWidth
+                                                  : Size - kWordWidth;
+  }
+
+  static constexpr std::uint32_t LoadWord(const char* p) {
+    if constexpr (kWordWidth == 4) {
+      return ReadInt32L(p);
+    } else {
+      std::uint32_t value = 0;
+      for (size_type j = 0; j < kWordWidth; j++)
+        value |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(p[j]))
+                 << (8 * j);
+      return value;
+    }
+  }
+
+  template <size_type... Index>
+  constexpr bool MatchWords(const char* p,
+                            std::index_sequence<Index...>) const {
+    return (((LoadWord(p + WordOffset(Index)) & mask_words_[Index]) ==
+             data_words_[Index]) &&
+            ...);
+  }
+
+  static constexpr int ParseHexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    throw std::invalid_argument("FixedBytePattern: invalid hex digit");
+  }
+};
+
+/// Makes a FixedBytePattern from a string literal, such as
+/// make_pattern("00 B5 ?? 48"). Declare the result constexpr so that a
+/// malformed pattern is rejected at compile time.
+template <std::size_t N>
+constexpr FixedBytePattern<N / 3> make_pattern(const char (&text)[N]) {
+  static_assert(N % 3 == 0,
+                "make_pattern: expected hex bytes separated by single spaces");
+  return FixedBytePattern<N / 3>{text};
+}
+
+}  // namespace saptapper
+
+#endif
@@ -0,0 +1,162 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "free_space_index.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "cpu_features.hpp"
+#include "types.hpp"
+
+#ifdef SAPTAPPER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace saptapper {
+
+namespace {
+
+constexpr std::size_t kAlign = 4;
+
+// Returns the first position in [pos, end) whose byte is not the filler, or
+// end if there is none.
+std::size_t SkipFiller(std::string_view rom, std::size_t pos, std::size_t end,
+                       char filler) {
+#ifdef SAPTAPPER_SSE2
+  const __m128i fillers = _mm_set1_epi8(filler);
+  while (pos + 16 <= end) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rom.data() + pos));
+    const auto mask = static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, fillers)));
+    if (mask != 0xffff) return pos + count_trailing_zeros(~mask);
+    pos += 16;
+  }
+#endif
+  while (pos < end && rom[pos] == filler) pos++;
+  return pos;
+}
+
+// Returns the first position pos + 4 * i within [pos, end) whose byte is the
+// filler. If there is none, returns the first such position at or after end.
+std::size_t FindAlignedFiller(std::string_view rom, std::size_t pos,
+                              std::size_t end, char filler) {
+#ifdef SAPTAPPER_SSE2
+  const __m128i fillers = _mm_set1_epi8(filler);
+  while (pos + 16 <= end) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rom.data() + pos));
+    // The first byte of each of the four words.
+    const auto mask = static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, fillers)) & 0x1111);
+    if (mask != 0) return pos + count_trailing_zeros(mask);
+    pos += 16;
+  }
+#endif
+  while (pos < end && rom[pos] != filler) pos += kAlign;
+  return pos;
+}
+
+}  // namespace
+
+FreeSpaceIndex::Builder::Builder(char filler, agbsize_t minimum_size)
+    : filler_(filler), minimum_size_(std::max<agbsize_t>(minimum_size, 1)) {}
+
+void FreeSpaceIndex::Builder::Feed(std::string_view rom, std::size_t end) {
+  for (;;) {
+    if (in_run_) {
+      const std::size_t run_end = SkipFiller(rom, cursor_, end, filler_);
+      if (run_end == end) {
+        cursor_ = end;
+        return;
+      }
+      Record(run_end);
+      cursor_ = (run_end + kAlign - 1) / kAlign * kAlign + kAlign;
+    } else {
+      if (cursor_ >= end) return;
+      cursor_ = FindAlignedFiller(rom, cursor_, end, filler_);
+      if (cursor_ >= end) return;
+      in_run_ = true;
+      run_start_ = cursor_;
+      cursor_++;
+    }
+  }
+}
+
+FreeSpaceIndex FreeSpaceIndex::Builder::Finish(std::string_view rom) {
+  Feed(rom, rom.size());
+  if (in_run_) Record(rom.size());
+  return FreeSpaceIndex{filler_, minimum_size_, std::move(runs_)};
+}
+
+void FreeSpaceIndex::Builder::Record(std::size_t run_end) {
+  in_run_ = false;
+  const std::size_t size = run_end - run_start_;
+  if (size >= minimum_size_) {
+    runs_.push_back(
+        {static_cast<agbsize_t>(run_start_), static_cast<agbsize_t>(size)});
+  }
+}
+
+FreeSpaceIndex::FreeSpaceIndex(char filler, agbsize_t minimum_size,
+                               std::vector<Run> runs)
+    : filler_(filler), minimum_size_(minimum_size), runs_(std::move(runs)) {
+  prefix_max_.reserve(runs_.size());
+  agbsize_t largest = 0;
+  for (const Run& run : runs_) {
+    largest = std::max(largest, run.size);
+    prefix_max_.push_back(largest);
+  }
+
+  by_size_.resize(runs_.size());
+  for (std::size_t i = 0; i < by_size_.size(); i++) by_size_[i] = i;
+  // Runs are in offset order, so a stable sort keeps equal sizes in order.
+  std::stable_sort(by_size_.begin(), by_size_.end(),
+                   [this](std::size_t a, std::size_t b) {
+                     return runs_[a].size < runs_[b].size;
+                   });
+}
+
+FreeSpaceIndex FreeSpaceIndex::Build(std::string_view rom, char filler,
+                                     agbsize_t minimum_size) {
+  return Builder{filler, minimum_size}.Finish(rom);
+}
+
+agbsize_t FreeSpaceIndex::FirstFit(agbsize_t size) const {
+  CheckSize(size);
+  const auto it =
+      std::lower_bound(prefix_max_.begin(), prefix_max_.end(), size);
+  if (it == prefix_max_.end()) return agbnpos;
+  return runs_[it - prefix_max_.begin()].offset;
+}
+
+agbsize_t FreeSpaceIndex::BestFit(agbsize_t size) const {
+  CheckSize(size);
+  const auto it = std::lower_bound(
+      by_size_.begin(), by_size_.end(), size,
+      [this](std::size_t index, agbsize_t value) {
+        return runs_[index].size < value;
+      });
+  if (it == by_size_.end()) return agbnpos;
+  return runs_[*it].offset;
+}
+
+agbsize_t FreeSpaceIndex::Largest(agbsize_t size) const {
+  if (runs_.empty()) return agbnpos;
+  const agbsize_t largest = prefix_max_.back();
+  if (largest < size) return agbnpos;
+  return FirstFit(largest);
+}
+
+void FreeSpaceIndex::CheckSize(agbsize_t size) const {
+  if (size < minimum_size_) {
+    throw std::invalid_argument(
+        "FreeSpaceIndex: the size is below the minimum recorded size");
+  }
+}
+
+}  // namespace saptapper
@@ -0,0 +1,90 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_FREE_SPACE_INDEX_HPP_
+#define SAPTAPPER_FREE_SPACE_INDEX_HPP_
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+
+namespace saptapper {
+
+/// Index of the runs of a filler byte (0xFF or 0x00) in a ROM image.
+///
+/// A run starts at a 4-byte-aligned offset, and the word that follows the
+/// end of a run is never the start of another, as Saptapper has always
+/// searched for free space. Only the runs of at least minimum_size() bytes
+/// are recorded, and queries are answered in O(log n).
+class FreeSpaceIndex {
+ public:
+  struct Run {
+    agbsize_t offset;
+    agbsize_t size;
+  };
+
+  static constexpr agbsize_t kDefaultMinimumSize = 64;
+
+  /// Records the runs while a ROM image is streamed through it in order.
+  class Builder {
+   public:
+    explicit Builder(char filler,
+                     agbsize_t minimum_size = kDefaultMinimumSize);
+
+    /// Advances through the bytes of the ROM before end.
+    void Feed(std::string_view rom, std::size_t end);
+
+    FreeSpaceIndex Finish(std::string_view rom);
+
+   private:
+    char filler_;
+    agbsize_t minimum_size_;
+    std::vector<Run> runs_;
+    std::size_t cursor_ = 0;
+    std::size_t run_start_ = 0;
+    bool in_run_ = false;
+
+    void Record(std::size_t run_end);
+  };
+
+  FreeSpaceIndex() = default;
+
+  static FreeSpaceIndex Build(std::string_view rom, char filler,
+                              agbsize_t minimum_size = kDefaultMinimumSize);
+
+  char filler() const noexcept { return filler_; }
+  agbsize_t minimum_size() const noexcept { return minimum_size_; }
+
+  /// The recorded runs in ROM order.
+  const std::vector<Run>& runs() const noexcept { return runs_; }
+
+  /// The offset of the first run of at least size bytes, or agbnpos.
+  agbsize_t FirstFit(agbsize_t size) const;
+
+  /// The offset of the smallest run of at least size bytes (the first one
+  /// of them), or agbnpos.
+  agbsize_t BestFit(agbsize_t size) const;
+
+  /// The offset of the largest run (the first one of them) if it has at
+  /// least size bytes, or agbnpos.
+  agbsize_t Largest(agbsize_t size = 0) const;
+
+ private:
+  char filler_ = '\0';
+  agbsize_t minimum_size_ = kDefaultMinimumSize;
+  std::vector<Run> runs_;
+
+  /// The size of the largest run among runs_[0] to runs_[i].
+  std::vector<agbsize_t> prefix_max_;
+
+  /// The indices of runs_ ordered by size, then by offset.
+  std::vector<std::size_t> by_size_;
+
+  FreeSpaceIndex(char filler, agbsize_t minimum_size, std::vector<Run> runs);
+
+  void CheckSize(agbsize_t size) const;
+};
+
+}  // namespace saptapper
+
+#endif
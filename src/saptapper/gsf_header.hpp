@@ -27,9 +27,9 @@ class GsfHeader {
   agbptr_t load_offset() const noexcept { return load_offset_; }
   agbptr_t load_size() const noexcept { return load_size_; }
 
- private:
   static constexpr size_type kSize = 12;
 
+ private:
   std::string str_;
   agbptr_t entrypoint_;
   agbptr_t load_offset_;
@@ -2,11 +2,20 @@
 
 #include "gsf_writer.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
 #include <string_view>
 #include <utility>
+#include <zlib.h>
+#include "bytes.hpp"
+#include "content_hash.hpp"
 #include "gsf_header.hpp"
+#include "output_sink.hpp"
+#include "parallel_deflate.hpp"
+#include "patched_rom_view.hpp"
 #include "psf_writer.hpp"
 #include "types.hpp"
 
@@ -14,44 +23,177 @@ namespace saptapper {
 
 void GsfWriter::SaveToFile(const std::filesystem::path& path,
                            const GsfHeader& header, std::string_view rom,
-                           const std::map<std::string, std::string>& tags) {
+                           const std::map<std::string, std::string>& tags,
+                           unsigned int threads) {
   std::ofstream file(path, std::ios::out | std::ios::binary);
   file.exceptions(std::ios::badbit);
-  SaveToStream(file, header, rom, tags);
+  SaveToStream(file, header, rom, tags, threads);
   file.close();
 }
 
 void GsfWriter::SaveToStream(std::ostream& out, const GsfHeader& header,
                              std::string_view rom,
-                             const std::map<std::string, std::string>& tags) {
-  PsfWriter psf{kVersion};
-  auto& exe = psf.exe();
-  exe.write(header.data(), header.size());
-  exe.write(rom.data(), rom.size());
-  psf.SaveToStream(out, tags);
+                             const std::map<std::string, std::string>& tags,
+                             unsigned int threads) {
+  PsfWriter::Lease psf{kVersion};
+  psf->set_threads(threads);
+  psf->AppendExe(std::string_view{header.data(), header.size()});
+  psf->AppendExe(rom);
+  psf->SaveToStream(out, tags);
+}
+
+void GsfWriter::SaveToSink(OutputSink& sink, const std::string& name,
+                           const GsfHeader& header, std::string_view rom,
+                           const std::map<std::string, std::string>& tags,
+                           unsigned int threads) {
+  SaveToStream(sink.CreateEntry(name), header, rom, tags, threads);
+  sink.CloseEntry();
+}
+
+void GsfWriter::SaveToFile(const std::filesystem::path& path,
+                           const GsfHeader& header, const PatchedRomView& rom,
+                           const std::map<std::string, std::string>& tags,
+                           unsigned int threads) {
+  std::ofstream file(path, std::ios::out | std::ios::binary);
+  file.exceptions(std::ios::badbit);
+  SaveToStream(file, header, rom, tags, threads);
+  file.close();
+}
+
+void GsfWriter::SaveToStream(std::ostream& out, const GsfHeader& header,
+                             const PatchedRomView& rom,
+                             const std::map<std::string, std::string>& tags,
+                             unsigned int threads) {
+  PsfWriter::Lease psf{kVersion};
+  psf->set_threads(threads);
+  psf->AppendExe(std::string_view{header.data(), header.size()});
+  for (const auto& segment : rom.segments()) psf->AppendExe(segment);
+  psf->SaveToStream(out, tags);
+}
+
+void GsfWriter::SaveToSink(OutputSink& sink, const std::string& name,
+                           const GsfHeader& header, const PatchedRomView& rom,
+                           const std::map<std::string, std::string>& tags,
+                           unsigned int threads) {
+  SaveToStream(sink.CreateEntry(name), header, rom, tags, threads);
+  sink.CloseEntry();
+}
+
+std::uint64_t GsfWriter::HashGsflib(
+    const GsfHeader& header, const PatchedRomView& rom,
+    const std::map<std::string, std::string>& tags) {
+  std::ostringstream settings;
+  settings << "gsf " << static_cast<int>(kVersion) << "; zlib " << ZLIB_VERSION
+           << "; level " << Z_BEST_COMPRESSION << "; block "
+           << ParallelDeflate::kBlockSize << "\n";
+  for (const auto& [name, value] : tags)
+    settings << name << "=" << value << "\n";
+
+  ContentHash hash;
+  hash.Update(settings.str());
+  hash.Update(std::string_view{header.data(), header.size()});
+  for (const auto& segment : rom.segments()) hash.Update(segment);
+  return hash.digest();
 }
 
 void GsfWriter::SaveMinigsfToFile(
     const std::filesystem::path& path, const MinigsfDriverParam& param,
     std::uint32_t song, const std::map<std::string, std::string>& tags) {
+  SaveMinigsfToFile(path, MinigsfTemplate{param}, song, tags);
+}
+
+void GsfWriter::SaveMinigsfToStream(
+    std::ostream& out, const MinigsfDriverParam& param, std::uint32_t song,
+    const std::map<std::string, std::string>& tags) {
+  SaveMinigsfToStream(out, MinigsfTemplate{param}, song, tags);
+}
+
+void GsfWriter::SaveMinigsfToSink(
+    OutputSink& sink, const std::string& name, const MinigsfDriverParam& param,
+    std::uint32_t song, const std::map<std::string, std::string>& tags) {
+  SaveMinigsfToSink(sink, name, MinigsfTemplate{param}, song, tags);
+}
+
+void GsfWriter::SaveMinigsfToFile(
+    const std::filesystem::path& path, const MinigsfTemplate& minigsf,
+    std::uint32_t song, const std::map<std::string, std::string>& tags) {
   std::ofstream file(path, std::ios::out | std::ios::binary);
   file.exceptions(std::ios::badbit);
-  SaveMinigsfToStream(file, param, song, tags);
+  SaveMinigsfToStream(file, minigsf, song, tags);
   file.close();
 }
 
 void GsfWriter::SaveMinigsfToStream(
-    std::ostream& out, const MinigsfDriverParam& param, std::uint32_t song,
+    std::ostream& out, const MinigsfTemplate& minigsf, std::uint32_t song,
     const std::map<std::string, std::string>& tags) {
+  MinigsfTemplate::buffer_type buffer;
+  const std::string_view data = minigsf.Stamp(song, buffer);
+  out.write(data.data(), data.size());
+  PsfWriter::WriteTags(out, tags);
+}
+
+void GsfWriter::SaveMinigsfToSink(
+    OutputSink& sink, const std::string& name, const MinigsfTemplate& minigsf,
+    std::uint32_t song, const std::map<std::string, std::string>& tags) {
+  SaveMinigsfToStream(sink.CreateEntry(name), minigsf, song, tags);
+  sink.CloseEntry();
+}
+
+GsfWriter::MinigsfTemplate::MinigsfTemplate(const MinigsfDriverParam& param)
+    : song_size_{std::min<std::size_t>(param.size(), 4)} {
   const agbptr_t entrypoint =
       is_romptr(param.address()) ? 0x8000000 : param.address() & 0xff000000;
   const GsfHeader gsf_header{entrypoint, param.address(), param.size()};
+  const auto exe_size = static_cast<std::uint32_t>(size() - kExeOffset);
+  const auto block_size =
+      static_cast<std::uint16_t>(gsf_header.size() + song_size_);
+
+  // PSF header (the CRC is stamped per song)
+  char* psf = image_.data();
+  std::memcpy(psf, "PSF", 3);
+  WriteInt8(&psf[3], kVersion);
+  WriteInt32L(&psf[4], 0);
+  WriteInt32L(&psf[8], exe_size);
+
+  // zlib header and a single final stored block
+  char* exe = &image_[kExeOffset];
+  WriteInt8(&exe[0], 0x78);
+  WriteInt8(&exe[1], 0x01);
+  WriteInt8(&exe[2], 0x01);
+  WriteInt16L(&exe[3], block_size);
+  WriteInt16L(&exe[5], static_cast<std::uint16_t>(~block_size));
+  std::memcpy(&exe[7], gsf_header.data(), gsf_header.size());
+
+  prefix_adler32_ = adler32(
+      1L, reinterpret_cast<const Bytef*>(&exe[7]), gsf_header.size());
+  prefix_crc32_ =
+      crc32(0L, reinterpret_cast<const Bytef*>(exe), kSongOffset - kExeOffset);
+}
+
+std::string_view GsfWriter::MinigsfTemplate::Stamp(std::uint32_t song,
+                                                   buffer_type& buffer) const {
+  buffer = image_;
+
+  char* song_data = &buffer[kSongOffset];
+  char song_bytes[4];
+  WriteInt32L(song_bytes, song);
+  std::memcpy(song_data, song_bytes, song_size_);
+
+  const auto adler = static_cast<std::uint32_t>(
+      adler32(prefix_adler32_, reinterpret_cast<const Bytef*>(song_data),
+              static_cast<uInt>(song_size_)));
+  char* trailer = song_data + song_size_;
+  WriteInt8(&trailer[0], (adler >> 24) & 0xff);
+  WriteInt8(&trailer[1], (adler >> 16) & 0xff);
+  WriteInt8(&trailer[2], (adler >> 8) & 0xff);
+  WriteInt8(&trailer[3], adler & 0xff);
 
-  char rom_data[4];
-  WriteInt32L(rom_data, song);
-  const std::string_view rom{rom_data, param.size()};
+  const auto crc = static_cast<std::uint32_t>(
+      crc32(prefix_crc32_, reinterpret_cast<const Bytef*>(song_data),
+            static_cast<uInt>(song_size_ + 4)));
+  WriteInt32L(&buffer[12], crc);
 
-  SaveToStream(out, gsf_header, rom, tags);
+  return std::string_view{buffer.data(), size()};
 }
 
 }  // namespace saptapper
@@ -3,6 +3,8 @@
 #ifndef SAPTAPPER_GSF_WRITER_HPP_
 #define SAPTAPPER_GSF_WRITER_HPP_
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <map>
@@ -10,18 +12,80 @@
 #include <string_view>
 #include "gsf_header.hpp"
 #include "minigsf_driver_param.hpp"
+#include "output_sink.hpp"
+#include "patched_rom_view.hpp"
 
 namespace saptapper {
 
 class GsfWriter {
  public:
+  /// Prebuilt minigsf file in which only the song number and the checksums
+  /// change from song to song.
+  ///
+  /// The exe is kept in a stored (uncompressed) deflate block, so a minigsf
+  /// is stamped out without running zlib or allocating memory.
+  class MinigsfTemplate {
+   public:
+    static constexpr std::size_t kMaximumSize =
+        16 + 2 + 5 + GsfHeader::kSize + 4 + 4;
+
+    using buffer_type = std::array<char, kMaximumSize>;
+
+    explicit MinigsfTemplate(const MinigsfDriverParam& param);
+
+    /// Writes the minigsf (without tags) into the buffer and returns the
+    /// written part of it.
+    std::string_view Stamp(std::uint32_t song, buffer_type& buffer) const;
+
+   private:
+    static constexpr std::size_t kExeOffset = 16;
+    static constexpr std::size_t kSongOffset = kExeOffset + 2 + 5 +
+                                               GsfHeader::kSize;
+
+    buffer_type image_{};
+    std::size_t song_size_ = 0;
+    std::uint32_t prefix_adler32_ = 0;
+    std::uint32_t prefix_crc32_ = 0;
+
+    std::size_t size() const noexcept { return kSongOffset + song_size_ + 4; }
+  };
+
   static void SaveToFile(const std::filesystem::path& path,
                          const GsfHeader& header, std::string_view rom,
-                         const std::map<std::string, std::string>& tags = {});
+                         const std::map<std::string, std::string>& tags = {},
+                         unsigned int threads = 0);
 
   static void SaveToStream(std::ostream& out, const GsfHeader& header,
                            std::string_view rom,
-                           const std::map<std::string, std::string>& tags = {});
+                           const std::map<std::string, std::string>& tags = {},
+                           unsigned int threads = 0);
+
+  /// Writes the file as the entry name of the sink.
+  static void SaveToSink(OutputSink& sink, const std::string& name,
+                         const GsfHeader& header, std::string_view rom,
+                         const std::map<std::string, std::string>& tags = {},
+                         unsigned int threads = 0);
+
+  static void SaveToFile(const std::filesystem::path& path,
+                         const GsfHeader& header, const PatchedRomView& rom,
+                         const std::map<std::string, std::string>& tags = {},
+                         unsigned int threads = 0);
+
+  static void SaveToStream(std::ostream& out, const GsfHeader& header,
+                           const PatchedRomView& rom,
+                           const std::map<std::string, std::string>& tags = {},
+                           unsigned int threads = 0);
+
+  static void SaveToSink(OutputSink& sink, const std::string& name,
+                         const GsfHeader& header, const PatchedRomView& rom,
+                         const std::map<std::string, std::string>& tags = {},
+                         unsigned int threads = 0);
+
+  /// The hash of everything that determines the bytes written by
+  /// SaveToFile: the exe, the tags and the compression settings.
+  static std::uint64_t HashGsflib(
+      const GsfHeader& header, const PatchedRomView& rom,
+      const std::map<std::string, std::string>& tags = {});
 
   static void SaveMinigsfToFile(
       const std::filesystem::path& path, const MinigsfDriverParam& param,
@@ -31,6 +95,24 @@ class GsfWriter {
       std::ostream& out, const MinigsfDriverParam& param, std::uint32_t song,
       const std::map<std::string, std::string>& tags = {});
 
+  static void SaveMinigsfToSink(
+      OutputSink& sink, const std::string& name,
+      const MinigsfDriverParam& param, std::uint32_t song,
+      const std::map<std::string, std::string>& tags = {});
+
+  static void SaveMinigsfToFile(
+      const std::filesystem::path& path, const MinigsfTemplate& minigsf,
+      std::uint32_t song, const std::map<std::string, std::string>& tags = {});
+
+  static void SaveMinigsfToStream(
+      std::ostream& out, const MinigsfTemplate& minigsf, std::uint32_t song,
+      const std::map<std::string, std::string>& tags = {});
+
+  static void SaveMinigsfToSink(
+      OutputSink& sink, const std::string& name,
+      const MinigsfTemplate& minigsf, std::uint32_t song,
+      const std::map<std::string, std::string>& tags = {});
+
  private:
   static constexpr std::uint8_t kVersion = 0x22;
 };
@@ -0,0 +1,71 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "gsflib_store.hpp"
+
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <ios>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+namespace saptapper {
+
+std::filesystem::path GsflibStore::Find(std::uint64_t key) const {
+  if (!enabled()) return {};
+
+  std::filesystem::path store_path{GetStorePath(key)};
+  std::error_code error;
+  if (!std::filesystem::is_regular_file(store_path, error)) return {};
+  return store_path;
+}
+
+std::filesystem::path GsflibStore::Add(
+    std::uint64_t key,
+    const std::function<void(std::ostream&)>& write) const {
+  if (!enabled()) return {};
+
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  if (error) return {};
+
+  // Renamed into place, so that a concurrent Find never finds a partial
+  // file.
+  std::filesystem::path store_path{GetStorePath(key)};
+  std::ostringstream suffix;
+  suffix << "." << std::hex << std::random_device{}() << ".tmp";
+  std::filesystem::path temp_path{store_path};
+  temp_path += suffix.str();
+
+  try {
+    std::ofstream file(temp_path, std::ios::out | std::ios::binary);
+    file.exceptions(std::ios::badbit | std::ios::failbit);
+    write(file);
+    file.close();
+  } catch (const std::exception&) {
+    std::filesystem::remove(temp_path, error);
+    return {};
+  }
+
+  std::filesystem::rename(temp_path, store_path, error);
+  if (error) {
+    std::filesystem::remove(temp_path, error);
+    return {};
+  }
+  return store_path;
+}
+
+std::filesystem::path GsflibStore::GetStorePath(std::uint64_t key) const {
+  std::ostringstream filename;
+  filename << std::hex << std::setfill('0') << std::setw(16) << key
+           << ".gsflib";
+  return directory_ / filename.str();
+}
+
+}  // namespace saptapper
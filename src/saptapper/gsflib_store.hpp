@@ -0,0 +1,53 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_GSFLIB_STORE_HPP_
+#define SAPTAPPER_GSFLIB_STORE_HPP_
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <utility>
+
+namespace saptapper {
+
+/// A directory of gsflib files named after the hash of their contents (see
+/// GsfWriter::HashGsflib), from which an identical gsflib is copied instead
+/// of being compressed again.
+///
+/// DirectoryOutputSink shares the stored files by hard links where the file
+/// system allows it, so a gsflib taken from the store must be replaced rather
+/// than edited in place.
+class GsflibStore {
+ public:
+  /// A disabled store.
+  GsflibStore() = default;
+
+  explicit GsflibStore(std::filesystem::path directory)
+      : directory_(std::move(directory)) {}
+
+  bool enabled() const noexcept { return !directory_.empty(); }
+
+  const std::filesystem::path& directory() const noexcept {
+    return directory_;
+  }
+
+  /// Returns the path of the stored gsflib with the key, or an empty path if
+  /// the store has none.
+  std::filesystem::path Find(std::uint64_t key) const;
+
+  /// Adds the gsflib written by write to the store and returns its path.
+  /// Errors are ignored, with an empty path returned.
+  std::filesystem::path Add(
+      std::uint64_t key,
+      const std::function<void(std::ostream&)>& write) const;
+
+ private:
+  std::filesystem::path directory_;
+
+  std::filesystem::path GetStorePath(std::uint64_t key) const;
+};
+
+}  // namespace saptapper
+
+#endif
@@ -0,0 +1,123 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "inspection_cache.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include "minigsf_driver_param.hpp"
+#include "mp2k_driver_param.hpp"
+#include "types.hpp"
+
+namespace saptapper {
+
+namespace {
+
+constexpr char kMagic[] = "saptapper-inspection";
+
+std::string ToHex(std::uint64_t value, int width) {
+  std::ostringstream stream;
+  stream << std::hex << std::setfill('0') << std::setw(width) << value;
+  return stream.str();
+}
+
+}  // namespace
+
+bool InspectionCache::Find(std::uint64_t rom_hash, std::size_t rom_size,
+                           Entry& entry) const {
+  if (!enabled()) return false;
+
+  std::ifstream file{GetRecordPath(rom_hash)};
+  if (!file) return false;
+
+  std::string magic;
+  int version = 0;
+  if (!(file >> magic >> version) || magic != kMagic || version != kVersion)
+    return false;
+
+  std::map<std::string, std::uint64_t> values;
+  std::string name;
+  std::string value;
+  while (file >> name >> value) {
+    try {
+      values[name] = std::stoull(value, nullptr, 0);
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+
+  for (const char* required :
+       {"rom_hash", "rom_size", "select_song_fn", "song_table", "song_count",
+        "main_fn", "init_fn", "vsync_fn", "minigsf_address", "minigsf_size",
+        "gsf_driver_addr"}) {
+    if (values.count(required) == 0) return false;
+  }
+  if (values["rom_hash"] != rom_hash || values["rom_size"] != rom_size)
+    return false;
+
+  auto address = [&values](const char* name) {
+    return static_cast<agbptr_t>(values[name]);
+  };
+  entry.param.set_select_song_fn(address("select_song_fn"));
+  entry.param.set_song_table(address("song_table"));
+  entry.param.set_song_count(static_cast<int>(values["song_count"]));
+  entry.param.set_main_fn(address("main_fn"));
+  entry.param.set_init_fn(address("init_fn"));
+  entry.param.set_vsync_fn(address("vsync_fn"));
+  entry.minigsf.set_address(address("minigsf_address"));
+  entry.minigsf.set_size(static_cast<agbsize_t>(values["minigsf_size"]));
+  entry.gsf_driver_addr = address("gsf_driver_addr");
+  return true;
+}
+
+void InspectionCache::Save(std::uint64_t rom_hash, std::size_t rom_size,
+                           const Entry& entry) const {
+  if (!enabled()) return;
+
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  if (error) return;
+
+  const std::filesystem::path path{GetRecordPath(rom_hash)};
+  std::filesystem::path temp_path{path};
+  temp_path += "." + ToHex(std::random_device{}(), 8) + ".tmp";
+
+  {
+    std::ofstream file{temp_path, std::ios::trunc};
+    file << kMagic << " " << kVersion << "\n"
+         << "rom_hash 0x" << ToHex(rom_hash, 16) << "\n"
+         << "rom_size " << rom_size << "\n"
+         << "select_song_fn 0x" << ToHex(entry.param.select_song_fn(), 8)
+         << "\n"
+         << "song_table 0x" << ToHex(entry.param.song_table(), 8) << "\n"
+         << "song_count " << entry.param.song_count() << "\n"
+         << "main_fn 0x" << ToHex(entry.param.main_fn(), 8) << "\n"
+         << "init_fn 0x" << ToHex(entry.param.init_fn(), 8) << "\n"
+         << "vsync_fn 0x" << ToHex(entry.param.vsync_fn(), 8) << "\n"
+         << "minigsf_address 0x" << ToHex(entry.minigsf.address(), 8) << "\n"
+         << "minigsf_size " << entry.minigsf.size() << "\n"
+         << "gsf_driver_addr 0x" << ToHex(entry.gsf_driver_addr, 8) << "\n";
+    file.close();
+    if (!file) {
+      std::filesystem::remove(temp_path, error);
+      return;
+    }
+  }
+
+  std::filesystem::rename(temp_path, path, error);
+  if (error) std::filesystem::remove(temp_path, error);
+}
+
+std::filesystem::path InspectionCache::GetRecordPath(
+    std::uint64_t rom_hash) const {
+  return directory_ / (ToHex(rom_hash, 16) + ".txt");
+}
+
+}  // namespace saptapper
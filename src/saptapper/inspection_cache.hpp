@@ -0,0 +1,62 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_INSPECTION_CACHE_HPP_
+#define SAPTAPPER_INSPECTION_CACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+#include "minigsf_driver_param.hpp"
+#include "mp2k_driver_param.hpp"
+#include "types.hpp"
+
+namespace saptapper {
+
+/// A directory of inspection results, one small text record per ROM named
+/// after the XXH64 hash of the image.
+///
+/// The cache is best effort: records that cannot be read, or that were
+/// written by other heuristics (see kVersion), are misses, and failures to
+/// write a record are ignored.
+class InspectionCache {
+ public:
+  struct Entry {
+    Mp2kDriverParam param;
+    MinigsfDriverParam minigsf;
+    agbptr_t gsf_driver_addr = agbnullptr;
+  };
+
+  /// Bump whenever the inspection of a ROM may give another result.
+  static constexpr int kVersion = 1;
+
+  /// A disabled cache.
+  InspectionCache() = default;
+
+  explicit InspectionCache(std::filesystem::path directory)
+      : directory_(std::move(directory)) {}
+
+  bool enabled() const noexcept { return !directory_.empty(); }
+
+  const std::filesystem::path& directory() const noexcept {
+    return directory_;
+  }
+
+  /// Reads the record of the ROM with the given hash and size.
+  bool Find(std::uint64_t rom_hash, std::size_t rom_size,
+            Entry& entry) const;
+
+  /// Writes the record of the ROM with the given hash and size. The record
+  /// is replaced atomically, so concurrent rips never see a partial one.
+  void Save(std::uint64_t rom_hash, std::size_t rom_size,
+            const Entry& entry) const;
+
+ private:
+  std::filesystem::path directory_;
+
+  std::filesystem::path GetRecordPath(std::uint64_t rom_hash) const;
+};
+
+}  // namespace saptapper
+
+#endif
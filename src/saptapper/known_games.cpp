@@ -0,0 +1,154 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "known_games.hpp"
+
+#include <zlib.h>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include "mp2k_driver_param.hpp"
+#include "types.hpp"
+
+namespace saptapper {
+
+namespace {
+
+constexpr KnownGame kKnownGames[] = {
+    // Matches no ROM (a game code has 4 characters), but keeps the table
+    // from being empty.
+    {"", 0, agbnullptr, agbnullptr, 0, agbnullptr, agbnullptr, agbnullptr,
+     agbnullptr},
+#include "known_games.inc"
+};
+
+constexpr std::size_t kKnownGameCount = std::size(kKnownGames);
+
+constexpr std::size_t kSlotCount = [] {
+  std::size_t count = 1;
+  while (count < 2 * kKnownGameCount) count *= 2;
+  return count;
+}();
+
+constexpr std::uint64_t MakeKey(std::string_view game_code,
+                                std::uint32_t header_crc) {
+  std::uint64_t key = header_crc;
+  for (const char c : game_code)
+    key = (key << 8) | static_cast<unsigned char>(c);
+  return key;
+}
+
+constexpr std::size_t GetSlot(std::uint64_t key, std::uint64_t seed) {
+  const std::uint64_t hash =
+      (key ^ (seed * 0xC2B2AE3D27D4EB4FULL)) * 0x9E3779B97F4A7C15ULL;
+  return static_cast<std::size_t>(hash >> 32) & (kSlotCount - 1);
+}
+
+// A collision-free slot assignment of kKnownGames.
+struct PerfectHash {
+  std::uint64_t seed = 0;
+  std::array<int, kSlotCount> slots{};
+  bool ok = false;
+};
+
+constexpr PerfectHash BuildPerfectHash() {
+  PerfectHash hash;
+  for (std::uint64_t seed = 0; seed < 0x10000; seed++) {
+    for (int& slot : hash.slots) slot = -1;
+
+    bool collided = false;
+    for (std::size_t i = 0; i < kKnownGameCount && !collided; i++) {
+      const KnownGame& game = kKnownGames[i];
+      const std::size_t slot =
+          GetSlot(MakeKey(game.game_code, game.header_crc), seed);
+      if (hash.slots[slot] != -1) {
+        collided = true;
+      } else {
+        hash.slots[slot] = static_cast<int>(i);
+      }
+    }
+
+    if (!collided) {
+      hash.seed = seed;
+      hash.ok = true;
+      return hash;
+    }
+  }
+  return hash;
+}
+
+constexpr PerfectHash kPerfectHash = BuildPerfectHash();
+static_assert(kPerfectHash.ok, "known_games.inc has duplicated entries");
+
+}  // namespace
+
+std::uint32_t KnownGames::HeaderCrc(std::string_view rom) {
+  const auto size = static_cast<uInt>(std::min<std::size_t>(
+      rom.size(), kHeaderSize));
+  return static_cast<std::uint32_t>(crc32(
+      crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(rom.data()), size));
+}
+
+const KnownGame* KnownGames::Find(std::string_view rom) {
+  if (rom.size() < kHeaderSize) return nullptr;
+
+  const std::string_view game_code = rom.substr(0xac, 4);
+  const std::uint32_t header_crc = HeaderCrc(rom);
+  const int index = kPerfectHash.slots[GetSlot(
+      MakeKey(game_code, header_crc), kPerfectHash.seed)];
+  if (index < 0) return nullptr;
+
+  const KnownGame& game = kKnownGames[index];
+  if (game.game_code != game_code || game.header_crc != header_crc)
+    return nullptr;
+  return &game;
+}
+
+std::string KnownGames::FormatEntry(std::string_view rom,
+                                    const Mp2kDriverParam& param,
+                                    agbptr_t gsf_driver_addr) {
+  auto printable = [](std::string_view text) {
+    std::string result;
+    for (const char c : text) {
+      if (c == '\0') break;
+      result.push_back(std::isprint(static_cast<unsigned char>(c)) ? c : '?');
+    }
+    return result;
+  };
+
+  auto address = [](agbptr_t value) {
+    std::ostringstream stream;
+    stream << "0x" << std::hex << std::setfill('0') << std::setw(8) << value;
+    return stream.str();
+  };
+
+  std::ostringstream entry;
+  const std::string_view header = rom.substr(0, kHeaderSize);
+  const std::string title{printable(header.substr(0xa0, 12))};
+  entry << "    // " << (title.empty() ? "(untitled)" : title) << std::endl;
+
+  entry << "    {\"";
+  for (const char c : header.substr(0xac, 4)) {
+    if (std::isalnum(static_cast<unsigned char>(c))) {
+      entry << c;
+    } else {
+      entry << "\\" << std::oct << std::setfill('0') << std::setw(3)
+            << static_cast<int>(static_cast<unsigned char>(c)) << std::dec;
+    }
+  }
+  entry << "\", " << address(HeaderCrc(rom)) << ", "
+        << address(param.select_song_fn()) << ", "
+        << address(param.song_table()) << ", " << param.song_count() << ","
+        << std::endl;
+  entry << "     " << address(param.main_fn()) << ", "
+        << address(param.init_fn()) << ", " << address(param.vsync_fn())
+        << ", " << address(gsf_driver_addr) << "},";
+  return entry.str();
+}
+
+}  // namespace saptapper
@@ -0,0 +1,63 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_KNOWN_GAMES_HPP_
+#define SAPTAPPER_KNOWN_GAMES_HPP_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "mp2k_driver_param.hpp"
+#include "types.hpp"
+
+namespace saptapper {
+
+/// The inspection result of a ROM that has been ripped and checked before.
+struct KnownGame {
+  std::string_view game_code;
+  std::uint32_t header_crc;
+  agbptr_t select_song_fn;
+  agbptr_t song_table;
+  int song_count;
+  agbptr_t main_fn;
+  agbptr_t init_fn;
+  agbptr_t vsync_fn;
+  agbptr_t gsf_driver_addr;
+
+  Mp2kDriverParam param() const {
+    Mp2kDriverParam param;
+    param.set_select_song_fn(select_song_fn);
+    param.set_song_table(song_table);
+    param.set_song_count(song_count);
+    param.set_main_fn(main_fn);
+    param.set_init_fn(init_fn);
+    param.set_vsync_fn(vsync_fn);
+    return param;
+  }
+};
+
+/// The table of known games in known_games.inc, looked up by game code and
+/// header CRC through a perfect hash built at compile time.
+class KnownGames {
+ public:
+  KnownGames() = delete;
+
+  /// The size of the cartridge header covered by HeaderCrc.
+  static constexpr agbsize_t kHeaderSize = 0xc0;
+
+  /// The CRC-32 of the cartridge header, which tells the revisions of a game
+  /// apart.
+  static std::uint32_t HeaderCrc(std::string_view rom);
+
+  /// Returns the entry with the game code and header CRC of the ROM, or
+  /// nullptr. The entry still has to be checked against the ROM itself.
+  static const KnownGame* Find(std::string_view rom);
+
+  /// Formats the entry of a ROM for known_games.inc.
+  static std::string FormatEntry(std::string_view rom,
+                                 const Mp2kDriverParam& param,
+                                 agbptr_t gsf_driver_addr);
+};
+
+}  // namespace saptapper
+
+#endif
@@ -2,35 +2,201 @@
 
 #include "mp2k_driver.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 #include "algorithm.hpp"
 #include "arm.hpp"
-#include "byte_pattern.hpp"
 #include "bytes.hpp"
+#include "call_graph_index.hpp"
+#include "content_hash.hpp"
+#include "fixed_byte_pattern.hpp"
 #include "mp2k_driver_param.hpp"
+#include "patched_rom_view.hpp"
+#include "rom_analysis.hpp"
+#include "rom_pointer_index.hpp"
+#include "signature_scanner.hpp"
 #include "types.hpp"
 
 namespace saptapper {
 
+namespace {
+
+using namespace std::literals::string_view_literals;
+
+// The signatures found by Mp2kDriver::scanner(), in order.
+enum : std::size_t {
+  kSelectSongFnSignature,
+  kInitFnSignature,
+  kInitFnSignature2,
+  kMainFnSignature,
+  kVSyncFnSignature,
+  kVSyncFnSignature2,
+};
+
+// m4aSongNumStart, matched loosely.
+constexpr std::string_view kSelectSongFnPattern{
+    "\x00\xb5\x00\x04\x07\x4a\x08\x49\x40\x0b"sv
+    "\x40\x18\x83\x88\x59\x00\xc9\x18\x89\x00"sv
+    "\x89\x18\x0a\x68\x01\x68\x10\x1c\x00\xf0"sv};
+
+// push {r4-r6,lr}; ldr r0, =(SoundMainRAM+1)
+constexpr auto kInitFnPattern = make_pattern("70 B5 14 48");
+static_assert(kInitFnPattern.Match("\x70\xb5\x14\x48"sv));
+
+// push {r4-r7,lr}; mov r7, r8
+constexpr auto kInitFnPattern2 = make_pattern("F0 B5 47 46");
+static_assert(kInitFnPattern2.Match("\xf0\xb5\x47\x46"sv));
+
+// push lr
+constexpr auto kMainFnPattern = make_pattern("00 B5");
+static_assert(kMainFnPattern.Match("\x00\xb5"sv));
+
+// LDR     R0, =dword_3007FF0
+// LDR     R0, [R0]
+// LDR     R2, =0x68736D53
+// LDR     R3, [R0]
+// SUBS (later versions) or CMP (earlier versions, such as Momotarou Matsuri)
+constexpr auto kVSyncFnPattern = make_pattern("?? 48 00 68 ?? 4A 03 68");
+static_assert(kVSyncFnPattern.Match("\xa6\x48\x00\x68\xa6\x4a\x03\x68"sv));
+static_assert(kVSyncFnPattern.Match("\x0e\x48\x00\x68\x0e\x4a\x03\x68"sv));
+static_assert(
+    !kVSyncFnPattern.Match("\xa6\x48\x00\x68\xa6\x4a\x03\x69"sv));
+
+// Pattern for Puyo Pop Fever, Precure, etc.:
+//
+// PUSH    {LR}
+// LDR     R0, =dword_3007FF0
+// LDR     R2, [R0]
+// LDR     R0, [R2]
+// LDR     R1, =0x978C92AD
+constexpr auto kVSyncFnPattern2 =
+    make_pattern("00 B5 ?? 48 02 68 10 68 ?? 49");
+static_assert(
+    kVSyncFnPattern2.Match("\x00\xb5\x18\x48\x02\x68\x10\x68\x17\x49"sv));
+static_assert(
+    !kVSyncFnPattern2.Match("\x00\xb5\x18\x48\x02\x68\x10\x68\x17\x4a"sv));
+
+// The driver functions all belong to the m4a library module, so the
+// fallback searches stay within this distance of the function they start
+// from. Beyond it the loose signatures (such as PUSH {LR}) match unrelated
+// functions all over the ROM.
+constexpr agbsize_t kFallbackDistance = 0x2000;
+
+// Returns the last hit before pos, within kFallbackDistance, that some call
+// lands on, or agbnullptr.
+agbptr_t FindCalledHitBefore(const std::vector<agbsize_t>& hits,
+                             const CallGraphIndex& calls, agbsize_t pos) {
+  const agbsize_t min_pos = pos >= kFallbackDistance ? pos - kFallbackDistance
+                                                     : 0;
+  auto it = std::lower_bound(hits.begin(), hits.end(), pos);
+  while (it != hits.begin() && *std::prev(it) >= min_pos) {
+    const agbsize_t offset = *--it;
+    if (calls.IsCallTarget(offset)) return to_romptr(offset);
+  }
+  return agbnullptr;
+}
+
+// Returns the first hit after pos, within kFallbackDistance, that some call
+// lands on, or agbnullptr.
+agbptr_t FindCalledHitAfter(const std::vector<agbsize_t>& hits,
+                            const CallGraphIndex& calls, agbsize_t pos) {
+  for (auto it = std::upper_bound(hits.begin(), hits.end(), pos);
+       it != hits.end() && *it - pos <= kFallbackDistance; ++it) {
+    if (calls.IsCallTarget(*it)) return to_romptr(*it);
+  }
+  return agbnullptr;
+}
+
+}  // namespace
+
+const SignatureScanner& Mp2kDriver::scanner() {
+  static const SignatureScanner scanner{{
+      {std::string{kSelectSongFnPattern}, "", 8},
+      SignatureScanner::MakeSignature(kInitFnPattern),
+      SignatureScanner::MakeSignature(kInitFnPattern2),
+      SignatureScanner::MakeSignature(kMainFnPattern),
+      SignatureScanner::MakeSignature(kVSyncFnPattern),
+      SignatureScanner::MakeSignature(kVSyncFnPattern2),
+  }};
+  return scanner;
+}
+
 Mp2kDriverParam Mp2kDriver::Inspect(std::string_view rom) {
+  return Inspect(rom, RomAnalysis::Analyze(rom, scanner()));
+}
+
+Mp2kDriverParam Mp2kDriver::Inspect(std::string_view rom,
+                                    const RomAnalysis& analysis) {
+  const SignatureScanner::Hits& hits = analysis.signature_hits();
+  const RomPointerIndex& pointers = analysis.pointers();
+  const CallGraphIndex& calls = analysis.calls();
+
   Mp2kDriverParam param;
-  param.set_select_song_fn(FindSelectSongFn(rom));
-  param.set_song_table(FindSongTable(rom, param.select_song_fn()));
-  param.set_main_fn(FindMainFn(rom, param.select_song_fn()));
-  param.set_init_fn(FindInitFn(rom, param.main_fn()));
-  param.set_vsync_fn(FindVSyncFn(rom, param.init_fn()));
-  param.set_song_count(ReadSongCount(rom, param.song_table()));
+  param.set_select_song_fn(FindSelectSongFn(hits));
+  param.set_song_table(
+      FindSongTable(rom, pointers, param.select_song_fn()));
+  param.set_main_fn(FindMainFn(rom, hits, calls, param.select_song_fn()));
+  param.set_init_fn(FindInitFn(rom, hits, calls, param.main_fn()));
+  param.set_vsync_fn(FindVSyncFn(rom, hits, calls, param.init_fn()));
+  param.set_song_count(ReadSongCount(rom, pointers, param.song_table()));
   return param;
 }
 
-void Mp2kDriver::InstallGsfDriver(std::string& rom, agbptr_t address,
-                                  const Mp2kDriverParam& param) {
+bool Mp2kDriver::Validate(std::string_view rom, const Mp2kDriverParam& param) {
+  if (!param.ok()) return false;
+
+  const agbsize_t select_song_fn_pos = to_offset(param.select_song_fn());
+  if (!is_romptr(param.select_song_fn()) || select_song_fn_pos % 4 != 0 ||
+      select_song_fn_pos >= rom.size() ||
+      rom.size() - select_song_fn_pos <= 40 + 4) {
+    return false;
+  }
+  if (!memcmp_loose(&rom[select_song_fn_pos], kSelectSongFnPattern.data(),
+                    kSelectSongFnPattern.size(), 8) ||
+      ReadInt32L(&rom[select_song_fn_pos + 40]) != param.song_table()) {
+    return false;
+  }
+
+  auto matches = [rom](agbptr_t address, const auto& pattern) {
+    return is_romptr(address) && pattern.Match(rom, to_offset(address));
+  };
+  if (!matches(param.main_fn(), kMainFnPattern) ||
+      !(matches(param.init_fn(), kInitFnPattern) ||
+        matches(param.init_fn(), kInitFnPattern2)) ||
+      !(matches(param.vsync_fn(), kVSyncFnPattern) ||
+        matches(param.vsync_fn(), kVSyncFnPattern2))) {
+    return false;
+  }
+
+  // The song table has exactly song_count entries, as ReadSongCount reads.
+  const agbsize_t song_table_pos = to_offset(param.song_table());
+  if (!is_romptr(param.song_table()) || param.song_count() < 0 ||
+      song_table_pos >= rom.size() ||
+      (rom.size() - song_table_pos) / 8 <
+          static_cast<std::size_t>(param.song_count())) {
+    return false;
+  }
+  for (int song = 0; song <= param.song_count(); song++) {
+    const std::size_t pos = song_table_pos + std::size_t{8} * song;
+    const bool entry =
+        pos + 8 <= rom.size() && is_romptr(ReadInt32L(&rom[pos]));
+    if (entry != (song < param.song_count())) return false;
+  }
+  return true;
+}
+
+PatchedRomView Mp2kDriver::InstallGsfDriver(std::string_view rom,
+                                            agbptr_t address,
+                                            const Mp2kDriverParam& param) {
   if (!is_romptr(address))
     throw std::invalid_argument("The gsf driver address is not valid.");
   if (!param.ok()) {
@@ -45,13 +211,17 @@ void Mp2kDriver::InstallGsfDriver(std::string& rom, agbptr_t address,
   if (offset + gsf_driver_size() > rom.size())
     throw std::out_of_range("The address of gsf driver block is out of range.");
 
-  std::memcpy(&rom[offset], gsf_driver_block, gsf_driver_size());
-  WriteInt32L(&rom[offset + kInitFnOffset], param.init_fn() | 1);
-  WriteInt32L(&rom[offset + kSelectSongFnOffset], param.select_song_fn() | 1);
-  WriteInt32L(&rom[offset + kMainFnOffset], param.main_fn() | 1);
-  WriteInt32L(&rom[offset + kVSyncFnOffset], param.vsync_fn() | 1);
-
-  WriteInt32L(rom.data(), make_arm_b(0x8000000, address));
+  std::array<char, gsf_driver_size()> block;
+  std::memcpy(block.data(), gsf_driver_block, gsf_driver_size());
+  WriteInt32L(&block[kInitFnOffset], param.init_fn() | 1);
+  WriteInt32L(&block[kSelectSongFnOffset], param.select_song_fn() | 1);
+  WriteInt32L(&block[kMainFnOffset], param.main_fn() | 1);
+  WriteInt32L(&block[kVSyncFnOffset], param.vsync_fn() | 1);
+
+  PatchedRomView patched{rom};
+  patched.Write(offset, std::string_view{block.data(), block.size()});
+  patched.WriteInt32L(0, make_arm_b(0x8000000, address));
+  return patched;
 }
 
 int Mp2kDriver::FindIdenticalSong(std::string_view rom, agbptr_t song_table,
@@ -71,45 +241,128 @@ int Mp2kDriver::FindIdenticalSong(std::string_view rom, agbptr_t song_table,
   return kNoSong;
 }
 
-agbptr_t Mp2kDriver::FindInitFn(std::string_view rom, agbptr_t main_fn) {
-  if (main_fn == agbnullptr) return agbnullptr;
+std::vector<int> Mp2kDriver::BuildDuplicateMap(std::string_view rom,
+                                               agbptr_t song_table,
+                                               int song_count) {
+  std::vector<int> origins(std::max(song_count, 0), kNoSong);
+  if (song_table == agbnullptr) return origins;
+
+  const agbsize_t start_pos = to_offset(song_table);
+  if (start_pos >= rom.size()) return origins;
 
-  using namespace std::literals::string_view_literals;
-  std::array patterns = {
-      "\x70\xb5\x14\x48"sv,  // push {r4-r6,lr}; ldr r0, =(SoundMainRAM+1)
-      "\xf0\xb5\x47\x46"sv,  // push {r4-r7,lr}; mov r7, r8
+  // Flat open-addressing table from an entry to the first song that has it.
+  struct Slot {
+    std::uint64_t entry;
+    int song = kNoSong;
   };
-  return find_backwards(rom, patterns, to_offset(main_fn), 0x100);
-}  // namespace saptapper
+  std::size_t capacity = 16;
+  while (capacity < origins.size() * 2) capacity *= 2;
+  std::vector<Slot> slots(capacity);
+  const std::size_t mask = capacity - 1;
+
+  for (int song = 0; song < song_count; song++) {
+    const std::size_t pos = start_pos + std::size_t{8} * song;
+    if (pos + 8 >= rom.size()) break;
+
+    const std::uint64_t entry =
+        ReadInt32L(&rom[pos]) |
+        (static_cast<std::uint64_t>(ReadInt32L(&rom[pos + 4])) << 32);
+    std::size_t index = ((entry * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (slots[index].song != kNoSong && slots[index].entry != entry)
+      index = (index + 1) & mask;
+
+    if (slots[index].song == kNoSong) {
+      slots[index] = {entry, song};
+    } else {
+      origins[song] = slots[index].song;
+    }
+  }
+  return origins;
+}
 
-agbptr_t Mp2kDriver::FindMainFn(std::string_view rom, agbptr_t select_song_fn) {
-  if (select_song_fn == agbnullptr) return agbnullptr;
+std::vector<int> Mp2kDriver::BuildContentDuplicateMap(std::string_view rom,
+                                                      agbptr_t song_table,
+                                                      int song_count) {
+  std::vector<int> origins{BuildDuplicateMap(rom, song_table, song_count)};
+  if (song_table == agbnullptr) return origins;
+
+  const agbsize_t start_pos = to_offset(song_table);
+  if (start_pos >= rom.size()) return origins;
+
+  std::unordered_map<agbptr_t, int> header_origins;
+  std::unordered_map<std::uint64_t, std::vector<int>> content_origins;
+  std::vector<std::string> contents(origins.size());
+  for (int song = 0; song < song_count; song++) {
+    const std::size_t pos = start_pos + std::size_t{8} * song;
+    if (pos + 8 >= rom.size()) break;
+    if (origins[song] != kNoSong) continue;
+
+    const agbptr_t song_header = ReadInt32L(&rom[pos]);
+    const auto header_it = header_origins.find(song_header);
+    if (header_it != header_origins.end()) {
+      origins[song] = header_it->second;
+      continue;
+    }
+    header_origins.emplace(song_header, song);
 
-  using namespace std::literals::string_view_literals;
-  std::array patterns{"\x00\xb5"sv};  // push lr
-  return find_backwards(rom, patterns, to_offset(select_song_fn), 0x20);
+    std::string& content = contents[song];
+    if (!ReadSongContent(rom, song_header, content)) continue;
+
+    auto& candidates = content_origins[ContentHash::Compute(content)];
+    for (const int candidate : candidates) {
+      if (contents[candidate] == content) {
+        origins[song] = candidate;
+        break;
+      }
+    }
+    if (origins[song] == kNoSong) candidates.push_back(song);
+  }
+  return origins;
 }
 
-agbptr_t Mp2kDriver::FindVSyncFn(std::string_view rom, agbptr_t init_fn) {
-  if (init_fn == agbnullptr) return agbnullptr;
+agbptr_t Mp2kDriver::FindInitFn(std::string_view rom,
+                                const SignatureScanner::Hits& hits,
+                                const CallGraphIndex& calls,
+                                agbptr_t main_fn) {
+  if (main_fn == agbnullptr) return agbnullptr;
 
-  using namespace std::literals::string_view_literals;
-  // LDR     R0, =dword_3007FF0
-  // LDR     R0, [R0]
-  // LDR     R2, =0x68736D53
-  // LDR     R3, [R0]
-  // SUBS (later versions) or CMP (earlier versions, such as Momotarou Matsuri)
-  const BytePattern pattern{"\xa6\x48\x00\x68\xa6\x4a\x03\x68"sv, "?xxx?xxx"sv};
+  const agbsize_t main_fn_pos = to_offset(main_fn);
+  agbptr_t init_fn =
+      find_backwards(rom, hits[kInitFnSignature], main_fn_pos, 0x100);
+  agbptr_t init_fn2 =
+      find_backwards(rom, hits[kInitFnSignature2], main_fn_pos, 0x100);
+  if (init_fn == agbnullptr && init_fn2 == agbnullptr) {
+    // Not in the usual place: the nearest function that is called.
+    init_fn = FindCalledHitBefore(hits[kInitFnSignature], calls, main_fn_pos);
+    init_fn2 =
+        FindCalledHitBefore(hits[kInitFnSignature2], calls, main_fn_pos);
+  }
+  if (init_fn == agbnullptr) return init_fn2;
+  if (init_fn2 == agbnullptr) return init_fn;
+  return std::max(init_fn, init_fn2);
+}
 
-  // Pattern for Puyo Pop Fever, Precure, etc.:
-  //
-  // PUSH    {LR}
-  // LDR     R0, =dword_3007FF0
-  // LDR     R2, [R0]
-  // LDR     R0, [R2]
-  // LDR     R1, =0x978C92AD
-  const BytePattern pattern2{"\x00\xb5\x18\x48\x02\x68\x10\x68\x17\x49"sv,
-                             "xx?xxxxx?x"sv};
+agbptr_t Mp2kDriver::FindMainFn(std::string_view rom,
+                                const SignatureScanner::Hits& hits,
+                                const CallGraphIndex& calls,
+                                agbptr_t select_song_fn) {
+  if (select_song_fn == agbnullptr) return agbnullptr;
+
+  const agbsize_t select_song_fn_pos = to_offset(select_song_fn);
+  const agbptr_t main_fn = find_backwards(rom, hits[kMainFnSignature],
+                                          select_song_fn_pos, 0x20);
+  if (main_fn != agbnullptr) return main_fn;
+
+  // Not in the usual place: the nearest function that is called.
+  return FindCalledHitBefore(hits[kMainFnSignature], calls,
+                             select_song_fn_pos);
+}
+
+agbptr_t Mp2kDriver::FindVSyncFn(std::string_view rom,
+                                 const SignatureScanner::Hits& hits,
+                                 const CallGraphIndex& calls,
+                                 agbptr_t init_fn) {
+  if (init_fn == agbnullptr) return agbnullptr;
 
   const agbsize_t init_fn_pos = to_offset(init_fn);
   if (init_fn_pos >= rom.size()) return agbnullptr;
@@ -121,19 +374,25 @@ agbptr_t Mp2kDriver::FindVSyncFn(std::string_view rom, agbptr_t init_fn) {
   assert(length % align == 0);
   if (rom.size() < length) return agbnullptr;
 
+  // Momotarou Matsuri, Puyo Pop Fever:
+  // check "BX LR" and avoid false-positive
+  auto returns_early = [rom](agbsize_t offset) {
+    return offset + 0x0c + 2 <= rom.size() &&
+           ReadInt16L(&rom[offset + 0x0c]) == 0x4770;
+  };
+
   // Regular version:
   //
   // Search backwards from m4aSoundInit function.
-  const agbsize_t max_pos = init_fn_pos - align;
-  const agbsize_t min_pos = init_fn_pos - length;
-  for (agbsize_t offset = max_pos; offset >= min_pos; offset -= align) {
-    if (pattern.Match(rom, offset)) {
-      // Momotarou Matsuri, Puyo Pop Fever:
-      // check "BX LR" and avoid false-positive
-      if (offset + 0x0c + 2 <= rom.size() &&
-          ReadInt16L(&rom[offset + 0x0c]) == 0x4770) {
-        continue;
-      }
+  const std::vector<agbsize_t>& vsync_hits = hits[kVSyncFnSignature];
+  if (init_fn_pos >= length) {
+    const agbsize_t min_pos = init_fn_pos - length;
+    auto it = std::lower_bound(vsync_hits.begin(), vsync_hits.end(),
+                               init_fn_pos);
+    while (it != vsync_hits.begin() && *std::prev(it) >= min_pos) {
+      const agbsize_t offset = *--it;
+      if ((init_fn_pos - offset) % align != 0) continue;
+      if (returns_early(offset)) continue;
 
       return to_romptr(offset);
     }
@@ -142,55 +401,230 @@ agbptr_t Mp2kDriver::FindVSyncFn(std::string_view rom, agbptr_t init_fn) {
   // Alternate version (Puyo Pop Fever, Precure, etc.):
   //
   // Search forwards from m4aSoundInit function.
+  const std::vector<agbsize_t>& vsync_hits2 = hits[kVSyncFnSignature2];
   const agbsize_t min_pos2 = init_fn_pos + align;
   const agbsize_t max_pos2 = std::min<agbsize_t>(
       init_fn_pos + length, static_cast<agbsize_t>(rom.size()));
-  for (agbsize_t offset = min_pos2; offset < max_pos2; offset += align) {
-    if (pattern2.Match(rom, offset))
-      return to_romptr(offset);
+  for (auto it = std::lower_bound(vsync_hits2.begin(), vsync_hits2.end(),
+                                  min_pos2);
+       it != vsync_hits2.end() && *it < max_pos2; ++it) {
+    if ((*it - init_fn_pos) % align == 0) return to_romptr(*it);
   }
 
-  return agbnullptr;
+  // Not in the usual place: the nearest function that is called, of the
+  // regular version before m4aSoundInit or else of the alternate one after.
+  const agbsize_t fallback_min_pos =
+      init_fn_pos >= kFallbackDistance ? init_fn_pos - kFallbackDistance : 0;
+  for (auto it = std::lower_bound(vsync_hits.begin(), vsync_hits.end(),
+                                  init_fn_pos);
+       it != vsync_hits.begin() && *std::prev(it) >= fallback_min_pos;) {
+    const agbsize_t offset = *--it;
+    if (calls.IsCallTarget(offset) && !returns_early(offset))
+      return to_romptr(offset);
+  }
+  return FindCalledHitAfter(vsync_hits2, calls, init_fn_pos);
 }
 
-agbptr_t Mp2kDriver::FindSelectSongFn(std::string_view rom) {
-  using namespace std::literals::string_view_literals;
-  const std::string_view pattern{
-      "\x00\xb5\x00\x04\x07\x4a\x08\x49\x40\x0b"sv
-      "\x40\x18\x83\x88\x59\x00\xc9\x18\x89\x00"sv
-      "\x89\x18\x0a\x68\x01\x68\x10\x1c\x00\xf0"sv};
-  return find_loose(rom, pattern, 8);
+agbptr_t Mp2kDriver::FindSelectSongFn(const SignatureScanner::Hits& hits) {
+  const std::vector<agbsize_t>& select_song_hits = hits[kSelectSongFnSignature];
+  if (select_song_hits.empty()) return agbnullptr;
+  return to_romptr(select_song_hits.front());
 }
 
 agbptr_t Mp2kDriver::FindSongTable(std::string_view rom,
+                                   const RomPointerIndex& pointers,
                                    agbptr_t select_song_fn) {
   if (select_song_fn == agbnullptr) return agbnullptr;
 
   const agbsize_t select_song_fn_pos = to_offset(select_song_fn);
   if (select_song_fn_pos + 40 + 4 > rom.size()) return agbnullptr;
 
-  const agbptr_t song_table = ReadInt32L(&rom[select_song_fn_pos + 40]);
-  if (!is_romptr(song_table)) return agbnullptr;
-  if (to_offset(song_table) >= rom.size()) return agbnullptr;
+  // The song table is referenced from the literal pool of m4aSongNumStart
+  // (which is 4-byte aligned, as all scanner hits are).
+  const agbsize_t literal_pos = select_song_fn_pos + 40;
+  if (!pointers.IsPointer(literal_pos)) return agbnullptr;
 
-  return song_table;
+  return ReadInt32L(&rom[literal_pos]);
 }
 
-int Mp2kDriver::ReadSongCount(std::string_view rom, agbptr_t song_table) {
+int Mp2kDriver::ReadSongCount(std::string_view rom,
+                              const RomPointerIndex& pointers,
+                              agbptr_t song_table) {
   if (song_table == agbnullptr) return 0;
 
   const agbsize_t song_table_pos = to_offset(song_table);
   if (rom.size() < 8) return 0;
   if (song_table_pos > rom.size() - 8) return 0;
 
+  const bool aligned = song_table_pos % 4 == 0;
   int song_count = 0;
   for (agbsize_t offset = song_table_pos; offset <= rom.size() - 8;
        offset += 8) {
-    const agbptr_t song = ReadInt32L(&rom[offset]);
-    if (!is_romptr(song)) break;
+    if (!(aligned ? pointers.IsRomPointer(offset)
+                  : is_romptr(ReadInt32L(&rom[offset]))))
+      break;
     song_count++;
   }
   return song_count;
 }
 
+bool Mp2kDriver::ReadSongContent(std::string_view rom,
+                                 agbptr_t song_header, std::string& content) {
+  if (!is_romptr(song_header)) return false;
+  const agbsize_t header_pos = to_offset(song_header);
+  if (header_pos >= rom.size() || rom.size() - header_pos < 8) return false;
+
+  const int track_count = static_cast<unsigned char>(rom[header_pos]);
+  if (track_count > kMaximumTrackCount) return false;
+  if (rom.size() - header_pos < 8 + std::size_t{4} * track_count)
+    return false;
+
+  // Track count, reverb and voicegroup. The block count and the priority
+  // do not change what is played.
+  content.clear();
+  content.push_back(rom[header_pos]);
+  content.push_back(rom[header_pos + 3]);
+  content.append(&rom[header_pos + 4], 4);
+
+  for (int track = 0; track < track_count; track++) {
+    const agbptr_t track_ptr = ReadInt32L(&rom[header_pos + 8 + 4 * track]);
+    if (!is_romptr(track_ptr) || to_offset(track_ptr) >= rom.size())
+      return false;
+    if (!ReadTrackContent(rom, to_offset(track_ptr), false, content))
+      return false;
+  }
+  return true;
+}
+
+bool Mp2kDriver::ReadTrackContent(std::string_view rom, agbsize_t track_pos,
+                                  bool pattern, std::string& content) {
+  constexpr unsigned char kFine = 0xb1;
+  constexpr unsigned char kGoto = 0xb2;
+  constexpr unsigned char kPattern = 0xb3;
+  constexpr unsigned char kPatternEnd = 0xb4;
+  constexpr unsigned char kRepeat = 0xb5;
+  constexpr unsigned char kMemoryAccess = 0xb9;
+  constexpr unsigned char kPriority = 0xba;
+  constexpr unsigned char kVoice = 0xbd;
+  constexpr unsigned char kTune = 0xc8;
+  constexpr unsigned char kExtendedCommand = 0xcd;
+  constexpr unsigned char kEndOfTie = 0xce;
+  constexpr unsigned char kTie = 0xcf;
+
+  // Reads the pointer operand at pos, relative to the start of the track.
+  auto read_pointer = [&](std::size_t pos, agbsize_t& target) {
+    if (pos + 4 > rom.size()) return false;
+    const agbptr_t address = ReadInt32L(&rom[pos]);
+    if (!is_romptr(address) || to_offset(address) >= rom.size()) return false;
+    target = to_offset(address);
+    char relative[4];
+    WriteInt32L(relative, target - track_pos);
+    content.append(relative, sizeof(relative));
+    return true;
+  };
+
+  const std::size_t end =
+      std::min<std::size_t>(rom.size(), track_pos + kMaximumTrackSize);
+  std::size_t pos = track_pos;
+
+  // Copies count operand bytes, which may take any value.
+  auto copy_operands = [&](std::size_t count) {
+    if (end - pos < count) return false;
+    content.append(&rom[pos], count);
+    pos += count;
+    return true;
+  };
+
+  // Copies up to count optional operands, each of which is present only if
+  // it is below 0x80.
+  auto copy_optional_operands = [&](int count) {
+    for (int i = 0; i < count && pos < end &&
+                    static_cast<unsigned char>(rom[pos]) < 0x80;
+         i++) {
+      content.push_back(rom[pos++]);
+    }
+  };
+
+  // A byte below 0x80 in place of a command repeats the last command from
+  // VOICE up (running status), with the byte as its first operand. Commands
+  // that take no operands are not remembered, as they could not consume it.
+  unsigned char running_status = 0;
+  while (pos < end) {
+    auto command = static_cast<unsigned char>(rom[pos]);
+    if (command < 0x80) {
+      if (running_status == 0) {
+        // Not a valid command. The driver would skip it.
+        content.push_back(rom[pos++]);
+        continue;
+      }
+      command = running_status;
+    } else {
+      pos++;
+      content.push_back(static_cast<char>(command));
+      if (command >= kVoice &&
+          (command <= kTune || command >= kExtendedCommand)) {
+        running_status = command;
+      }
+    }
+
+    agbsize_t target;
+    switch (command) {
+      case kFine:
+        return true;
+
+      case kGoto:
+        // The rest of the track is never reached.
+        return read_pointer(pos, target);
+
+      case kPatternEnd:
+        if (pattern) return true;
+        break;
+
+      case kPattern:
+        if (!read_pointer(pos, target)) return false;
+        pos += 4;
+        if (!pattern && !ReadTrackContent(rom, target, true, content))
+          return false;
+        break;
+
+      case kRepeat:
+        if (!copy_operands(1)) return false;
+        if (!read_pointer(pos, target)) return false;
+        pos += 4;
+        break;
+
+      case kMemoryAccess:
+        if (!copy_operands(3)) return false;
+        break;
+
+      case kExtendedCommand:
+        // The sub-command and its value.
+        if (!copy_operands(2)) return false;
+        break;
+
+      case kEndOfTie:
+        // The key.
+        copy_optional_operands(1);
+        break;
+
+      case kTie:
+        // The key and the velocity.
+        copy_optional_operands(2);
+        break;
+
+      default:
+        if (command > kTie) {
+          // A note: the key, the velocity and the extra gate time.
+          copy_optional_operands(3);
+        } else if (command >= kPriority && command <= kTune) {
+          if (!copy_operands(1)) return false;
+        }
+        // The waits (below FINE) and the commands the driver does not
+        // define take no operands.
+        break;
+    }
+  }
+  return false;
+}
+
 }  // namespace saptapper
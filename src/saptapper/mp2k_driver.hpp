@@ -5,7 +5,13 @@
 
 #include <string>
 #include <string_view>
+#include <vector>
+#include "call_graph_index.hpp"
 #include "mp2k_driver_param.hpp"
+#include "patched_rom_view.hpp"
+#include "rom_analysis.hpp"
+#include "rom_pointer_index.hpp"
+#include "signature_scanner.hpp"
 #include "types.hpp"
 
 namespace saptapper {
@@ -28,14 +34,41 @@ class Mp2kDriver {
 
   static std::string name() { return "MusicPlayer2000"; }
 
+  /// The scanner for the signatures of the driver functions.
+  static const SignatureScanner& scanner();
+
   static Mp2kDriverParam Inspect(std::string_view rom);
 
-  static void InstallGsfDriver(std::string& rom, agbptr_t address,
-                               const Mp2kDriverParam& param);
+  /// Inspects the ROM given its analysis with scanner().
+  static Mp2kDriverParam Inspect(std::string_view rom,
+                                 const RomAnalysis& analysis);
+
+  /// Whether the param describes the driver in the ROM, judging by the code
+  /// and the song table that it points to.
+  static bool Validate(std::string_view rom, const Mp2kDriverParam& param);
+
+  static PatchedRomView InstallGsfDriver(std::string_view rom,
+                                        agbptr_t address,
+                                        const Mp2kDriverParam& param);
 
   static int FindIdenticalSong(std::string_view rom, agbptr_t song_table,
                                int song);
 
+  /// Returns, for each of the first song_count songs, the first song with an
+  /// identical song table entry (as FindIdenticalSong would), or kNoSong.
+  static std::vector<int> BuildDuplicateMap(std::string_view rom,
+                                            agbptr_t song_table,
+                                            int song_count);
+
+  /// Like BuildDuplicateMap, but a song is also a duplicate of the first
+  /// song that plays the same sequence: the same track count, reverb and
+  /// voicegroup, and the same track data (followed through patterns, with
+  /// pointers taken relative to the track). Songs whose data cannot be read
+  /// are compared by their song table entry only.
+  static std::vector<int> BuildContentDuplicateMap(std::string_view rom,
+                                                   agbptr_t song_table,
+                                                   int song_count);
+
  private:
   static constexpr agbsize_t kInitFnOffset = 0xd8;
   static constexpr agbsize_t kSelectSongFnOffset = 0xdc;
@@ -43,6 +76,9 @@ class Mp2kDriver {
   static constexpr agbsize_t kVSyncFnOffset = 0xe4;
   static constexpr agbsize_t kSongNumberOffset = 0xe8;
 
+  static constexpr int kMaximumTrackCount = 16;
+  static constexpr agbsize_t kMaximumTrackSize = 0x10000;
+
   static constexpr unsigned char gsf_driver_block[244] = {
       0x01, 0x10, 0x8F, 0xE2, 0x11, 0xFF, 0x2F, 0xE1, 0x02, 0xA0, 0x01, 0x68,
       0x04, 0x30, 0x0A, 0x0E, 0xFB, 0xD1, 0x1F, 0xE0, 0x53, 0x61, 0x70, 0x70,
@@ -66,12 +102,28 @@ class Mp2kDriver {
       0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x2B, 0x00, 0xD0,
       0x18, 0x47, 0x70, 0x47};
 
-  static agbptr_t FindInitFn(std::string_view rom, agbptr_t main_fn);
-  static agbptr_t FindMainFn(std::string_view rom, agbptr_t select_song_fn);
-  static agbptr_t FindVSyncFn(std::string_view rom, agbptr_t init_fn);
-  static agbptr_t FindSelectSongFn(std::string_view rom);
-  static agbptr_t FindSongTable(std::string_view rom, agbptr_t select_song_fn);
-  static int ReadSongCount(std::string_view rom, agbptr_t song_table);
+  static agbptr_t FindInitFn(std::string_view rom,
+                             const SignatureScanner::Hits& hits,
+                             const CallGraphIndex& calls, agbptr_t main_fn);
+  static agbptr_t FindMainFn(std::string_view rom,
+                             const SignatureScanner::Hits& hits,
+                             const CallGraphIndex& calls,
+                             agbptr_t select_song_fn);
+  static agbptr_t FindVSyncFn(std::string_view rom,
+                              const SignatureScanner::Hits& hits,
+                              const CallGraphIndex& calls, agbptr_t init_fn);
+  static agbptr_t FindSelectSongFn(const SignatureScanner::Hits& hits);
+  static agbptr_t FindSongTable(std::string_view rom,
+                                const RomPointerIndex& pointers,
+                                agbptr_t select_song_fn);
+  static int ReadSongCount(std::string_view rom,
+                           const RomPointerIndex& pointers,
+                           agbptr_t song_table);
+
+  static bool ReadSongContent(std::string_view rom, agbptr_t song_header,
+                              std::string& content);
+  static bool ReadTrackContent(std::string_view rom, agbsize_t track_pos,
+                               bool pattern, std::string& content);
 };
 
 }  // namespace saptapper
@@ -0,0 +1,180 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "output_sink.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace saptapper {
+
+void OutputSink::CopyEntry(const std::string& name,
+                           const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  file.exceptions(std::ios::badbit);
+  if (!file) {
+    throw std::filesystem::filesystem_error(
+        "Unable to open the file",
+        path, std::make_error_code(std::errc::no_such_file_or_directory));
+  }
+
+  std::ostream& out = CreateEntry(name);
+  if (file.peek() != std::ifstream::traits_type::eof()) out << file.rdbuf();
+  CloseEntry();
+}
+
+std::ostream& DirectoryOutputSink::CreateEntry(const std::string& name) {
+  const std::filesystem::path path{PrepareEntry(name)};
+  std::error_code error;
+  std::filesystem::remove(path, error);
+
+  file_.open(path, std::ios::out | std::ios::binary);
+  file_.exceptions(std::ios::badbit);
+  if (!file_) {
+    throw std::filesystem::filesystem_error(
+        "Unable to create the file", path,
+        std::make_error_code(std::errc::io_error));
+  }
+  return file_;
+}
+
+void DirectoryOutputSink::CloseEntry() {
+  file_.close();
+  if (!file_) throw std::ios_base::failure("Unable to write the file.");
+  file_.clear();
+}
+
+void DirectoryOutputSink::CopyEntry(const std::string& name,
+                                    const std::filesystem::path& path) {
+  const std::filesystem::path entry_path{PrepareEntry(name)};
+  std::error_code error;
+  std::filesystem::remove(entry_path, error);
+
+  std::filesystem::create_hard_link(path, entry_path, error);
+  if (!error) return;
+
+  std::filesystem::copy_file(path, entry_path,
+                             std::filesystem::copy_options::overwrite_existing);
+}
+
+std::filesystem::path DirectoryOutputSink::PrepareEntry(
+    const std::string& name) {
+  std::filesystem::path path{directory_};
+  path /= std::filesystem::u8path(name);
+
+  // Sets are written into a single directory, so it is created only once.
+  const std::filesystem::path parent{path.parent_path()};
+  if (!parent.empty() && parent != created_directory_) {
+    std::filesystem::create_directories(parent);
+    created_directory_ = parent;
+  }
+  return path;
+}
+
+BatchDirectoryOutputSink::BatchDirectoryOutputSink(
+    std::filesystem::path directory, bool use_io_uring)
+    : DirectoryOutputSink(directory),
+      writer_{std::move(directory), use_io_uring} {}
+
+std::ostream& BatchDirectoryOutputSink::CreateEntry(const std::string& name) {
+  entry_batched_ = IsBatched(name);
+  if (!entry_batched_) {
+    Flush();
+    return DirectoryOutputSink::CreateEntry(name);
+  }
+
+  PrepareEntry(name);
+  entry_.Release();
+  entry_name_ = name;
+  return entry_;
+}
+
+void BatchDirectoryOutputSink::CloseEntry() {
+  if (!entry_batched_) {
+    DirectoryOutputSink::CloseEntry();
+    return;
+  }
+
+  batch_.push_back({std::move(entry_name_), entry_.Release()});
+  batch_bytes_ += batch_.back().data.size();
+  if (batch_.size() >= kMaximumBatchFiles ||
+      batch_bytes_ >= kMaximumBatchBytes) {
+    Flush();
+  }
+}
+
+void BatchDirectoryOutputSink::CopyEntry(const std::string& name,
+                                         const std::filesystem::path& path) {
+  Flush();
+  DirectoryOutputSink::CopyEntry(name, path);
+}
+
+void BatchDirectoryOutputSink::Close() { Flush(); }
+
+bool BatchDirectoryOutputSink::IsBatched(const std::string& name) {
+  constexpr std::string_view kExtension{".minigsf"};
+  return name.size() >= kExtension.size() &&
+         name.compare(name.size() - kExtension.size(), kExtension.size(),
+                      kExtension) == 0;
+}
+
+void BatchDirectoryOutputSink::Flush() {
+  // The batch is dropped even if it fails, as the error is thrown.
+  std::vector<BatchFileWriter::File> batch;
+  batch.swap(batch_);
+  batch_bytes_ = 0;
+  writer_.Write(batch);
+}
+
+std::ostream& MemoryOutputSink::CreateEntry(const std::string& name) {
+  entry_.Release();
+  entry_name_ = name;
+  return entry_;
+}
+
+void MemoryOutputSink::CloseEntry() {
+  entries_.push_back({std::move(entry_name_), entry_.Release(), {}});
+}
+
+void MemoryOutputSink::CopyEntry(const std::string& name,
+                                 const std::filesystem::path& path) {
+  if (!keep_copies_by_path_) {
+    OutputSink::CopyEntry(name, path);
+    return;
+  }
+  entries_.push_back({name, {}, path});
+}
+
+void MemoryOutputSink::WriteTo(OutputSink& sink) const {
+  for (const Entry& entry : entries_) {
+    if (!entry.source.empty()) {
+      sink.CopyEntry(entry.name, entry.source);
+      continue;
+    }
+
+    std::ostream& out = sink.CreateEntry(entry.name);
+    out.write(entry.data.data(), entry.data.size());
+    sink.CloseEntry();
+  }
+}
+
+std::ostream& CallbackOutputSink::CreateEntry(const std::string& name) {
+  entry_.str(std::string{});
+  entry_.clear();
+  entry_name_ = name;
+  return entry_;
+}
+
+void CallbackOutputSink::CloseEntry() {
+  const std::string data{entry_.str()};
+  entry_.str(std::string{});
+  callback_(entry_name_, data);
+}
+
+}  // namespace saptapper
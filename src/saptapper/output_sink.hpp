@@ -0,0 +1,168 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_OUTPUT_SINK_HPP_
+#define SAPTAPPER_OUTPUT_SINK_HPP_
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "batch_file_writer.hpp"
+#include "string_output_stream.hpp"
+
+namespace saptapper {
+
+/// Where the files of a GSF set go. The files (entries) are written one at a
+/// time: CreateEntry starts one and returns the stream to write it to, which
+/// stays valid until CloseEntry.
+///
+/// Entry names are relative paths in UTF-8, with '/' as the separator.
+class OutputSink {
+ public:
+  virtual ~OutputSink() = default;
+
+  virtual std::ostream& CreateEntry(const std::string& name) = 0;
+
+  virtual void CloseEntry() = 0;
+
+  /// Adds a copy of the file at path as an entry.
+  virtual void CopyEntry(const std::string& name,
+                         const std::filesystem::path& path);
+
+  /// Completes the output. No entry may be created afterwards.
+  virtual void Close() {}
+};
+
+/// Writes each entry to a file under a directory.
+class DirectoryOutputSink : public OutputSink {
+ public:
+  explicit DirectoryOutputSink(std::filesystem::path directory)
+      : directory_(std::move(directory)) {}
+
+  const std::filesystem::path& directory() const noexcept {
+    return directory_;
+  }
+
+  /// Replaces the file of the entry. An existing file is removed rather than
+  /// truncated, as it may be a hard link made by CopyEntry.
+  std::ostream& CreateEntry(const std::string& name) override;
+
+  void CloseEntry() override;
+
+  /// Makes the file of the entry a hard link to the file at path where the
+  /// file system allows it, and a copy otherwise.
+  void CopyEntry(const std::string& name,
+                 const std::filesystem::path& path) override;
+
+ protected:
+  // Returns the path of the entry, creating its directory if needed.
+  std::filesystem::path PrepareEntry(const std::string& name);
+
+ private:
+  std::filesystem::path directory_;
+  std::filesystem::path created_directory_;
+  std::ofstream file_;
+};
+
+/// Like DirectoryOutputSink, but keeps the minigsf entries in memory and
+/// writes them in batches with BatchFileWriter. Other entries, such as the
+/// gsflib, can be large and are written straight to their files. Close must
+/// be called to write the last batch.
+class BatchDirectoryOutputSink : public DirectoryOutputSink {
+ public:
+  explicit BatchDirectoryOutputSink(std::filesystem::path directory,
+                                    bool use_io_uring = true);
+
+  std::ostream& CreateEntry(const std::string& name) override;
+
+  void CloseEntry() override;
+
+  void CopyEntry(const std::string& name,
+                 const std::filesystem::path& path) override;
+
+  void Close() override;
+
+ private:
+  static constexpr std::size_t kMaximumBatchFiles = 512;
+  static constexpr std::size_t kMaximumBatchBytes = 64 * 1024 * 1024;
+
+  BatchFileWriter writer_;
+  std::vector<BatchFileWriter::File> batch_;
+  std::size_t batch_bytes_ = 0;
+  StringOutputStream entry_;
+  std::string entry_name_;
+  bool entry_batched_ = false;
+
+  // Returns true if the entry is small enough to be batched.
+  static bool IsBatched(const std::string& name);
+
+  void Flush();
+};
+
+/// Keeps the entries in memory.
+class MemoryOutputSink : public OutputSink {
+ public:
+  struct Entry {
+    std::string name;
+    std::string data;
+
+    /// The file that CopyEntry was given, if the entry was kept by path. Its
+    /// data is empty then.
+    std::filesystem::path source;
+  };
+
+  /// With keep_copies_by_path, CopyEntry only records the path of the file,
+  /// which must stay in place as long as the entry is used.
+  explicit MemoryOutputSink(bool keep_copies_by_path = false)
+      : keep_copies_by_path_(keep_copies_by_path) {}
+
+  /// The closed entries, in the order they were created.
+  const std::vector<Entry>& entries() const noexcept { return entries_; }
+  std::vector<Entry>& entries() noexcept { return entries_; }
+
+  std::ostream& CreateEntry(const std::string& name) override;
+
+  void CloseEntry() override;
+
+  void CopyEntry(const std::string& name,
+                 const std::filesystem::path& path) override;
+
+  /// Writes the entries to another sink, in order. An entry kept by path is
+  /// copied there with CopyEntry, so that the sink can link the file.
+  void WriteTo(OutputSink& sink) const;
+
+ private:
+  bool keep_copies_by_path_;
+  std::vector<Entry> entries_;
+  StringOutputStream entry_;
+  std::string entry_name_;
+};
+
+/// Passes each entry to a function as it is closed.
+class CallbackOutputSink : public OutputSink {
+ public:
+  using Callback =
+      std::function<void(const std::string& name, std::string_view data)>;
+
+  explicit CallbackOutputSink(Callback callback)
+      : callback_(std::move(callback)) {}
+
+  std::ostream& CreateEntry(const std::string& name) override;
+
+  void CloseEntry() override;
+
+ private:
+  Callback callback_;
+  std::ostringstream entry_;
+  std::string entry_name_;
+};
+
+}  // namespace saptapper
+
+#endif
@@ -0,0 +1,335 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "parallel_deflate.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+namespace saptapper {
+
+namespace {
+
+constexpr int kWindowBits = 15;
+constexpr int kMemoryLevel = 8;
+
+// Concatenated view over the input segments.
+class SegmentReader {
+ public:
+  explicit SegmentReader(const std::vector<std::string_view>& segments)
+      : segments_(segments) {
+    starts_.reserve(segments.size());
+    for (const auto& segment : segments) {
+      starts_.push_back(size_);
+      size_ += segment.size();
+    }
+  }
+
+  std::size_t size() const noexcept { return size_; }
+
+  void Copy(std::size_t pos, std::size_t count, char* dest) const {
+    auto it = std::upper_bound(starts_.begin(), starts_.end(), pos);
+    std::size_t index = std::distance(starts_.begin(), it) - 1;
+    while (count != 0) {
+      const std::string_view& segment = segments_[index];
+      const std::size_t offset = pos - starts_[index];
+      const std::size_t length = std::min(count, segment.size() - offset);
+      std::memcpy(dest, segment.data() + offset, length);
+      dest += length;
+      pos += length;
+      count -= length;
+      index++;
+    }
+  }
+
+ private:
+  const std::vector<std::string_view>& segments_;
+  std::vector<std::size_t> starts_;
+  std::size_t size_ = 0;
+};
+
+// Raw deflate state of a single worker.
+class Deflater {
+ public:
+  explicit Deflater(int level) {
+    std::memset(&stream_, 0, sizeof(stream_));
+    if (deflateInit2(&stream_, level, Z_DEFLATED, -kWindowBits, kMemoryLevel,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+      throw std::runtime_error("deflateInit2 failed");
+  }
+
+  Deflater(const Deflater&) = delete;
+  Deflater& operator=(const Deflater&) = delete;
+
+  ~Deflater() { deflateEnd(&stream_); }
+
+  // Compresses a block of `input` that starts at `dictionary_size`. The last
+  // block terminates the deflate stream, the others end on a byte boundary.
+  void CompressBlock(const std::vector<char>& input,
+                     std::size_t dictionary_size, bool last,
+                     std::string& output) {
+    if (deflateReset(&stream_) != Z_OK)
+      throw std::runtime_error("deflateReset failed");
+    if (dictionary_size != 0 &&
+        deflateSetDictionary(&stream_,
+                             reinterpret_cast<const Bytef*>(input.data()),
+                             static_cast<uInt>(dictionary_size)) != Z_OK)
+      throw std::runtime_error("deflateSetDictionary failed");
+
+    const std::size_t block_size = input.size() - dictionary_size;
+    output.resize(deflateBound(&stream_, static_cast<uLong>(block_size)) + 16);
+    stream_.next_in = reinterpret_cast<Bytef*>(
+        const_cast<char*>(input.data() + dictionary_size));
+    stream_.avail_in = static_cast<uInt>(block_size);
+
+    const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    std::size_t written = 0;
+    for (;;) {
+      stream_.next_out = reinterpret_cast<Bytef*>(&output[written]);
+      stream_.avail_out = static_cast<uInt>(output.size() - written);
+      const int result = deflate(&stream_, flush);
+      if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+        throw std::runtime_error("deflate failed");
+      written = output.size() - stream_.avail_out;
+
+      if (result == Z_STREAM_END) break;
+      if (!last && stream_.avail_in == 0 && stream_.avail_out != 0) break;
+      output.resize(output.size() * 2);
+    }
+    output.resize(written);
+  }
+
+ private:
+  z_stream stream_;
+};
+
+struct Block {
+  std::string data;
+  uLong adler = 0;
+  std::size_t size = 0;
+  bool ready = false;
+};
+
+// The deflate state and the input buffer of a worker.
+struct WorkerState {
+  explicit WorkerState(int level) : level{level}, deflater{level} {}
+
+  int level;
+  Deflater deflater;
+  std::vector<char> buffer;
+};
+
+// Worker states and block buffers that outlive a compression, so that the
+// next one starts warm (deflateReset instead of deflateInit2) and without
+// allocating.
+class StatePool {
+ public:
+  StatePool()
+      : capacity_{2 * std::max(1u, std::thread::hardware_concurrency())} {}
+
+  std::unique_ptr<WorkerState> AcquireState(int level) {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      for (auto it = states_.rbegin(); it != states_.rend(); ++it) {
+        if ((*it)->level != level) continue;
+        std::unique_ptr<WorkerState> state = std::move(*it);
+        states_.erase(std::next(it).base());
+        return state;
+      }
+    }
+    return std::make_unique<WorkerState>(level);
+  }
+
+  void ReleaseState(std::unique_ptr<WorkerState> state) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (states_.size() < capacity_) states_.push_back(std::move(state));
+  }
+
+  std::string AcquireOutput() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (outputs_.empty()) return {};
+    std::string output = std::move(outputs_.back());
+    outputs_.pop_back();
+    return output;
+  }
+
+  void ReleaseOutput(std::string output) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (outputs_.size() < 2 * capacity_) outputs_.push_back(std::move(output));
+  }
+
+ private:
+  std::size_t capacity_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<WorkerState>> states_;
+  std::vector<std::string> outputs_;
+};
+
+StatePool& GetStatePool() {
+  static StatePool pool;
+  return pool;
+}
+
+}  // namespace
+
+void ParallelDeflate::Compress(const std::vector<std::string_view>& input,
+                               const Sink& sink) const {
+  const SegmentReader reader{input};
+  const std::size_t block_count =
+      std::max<std::size_t>(1, (reader.size() + kBlockSize - 1) / kBlockSize);
+
+  unsigned int threads = threads_;
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = static_cast<unsigned int>(
+      std::min<std::size_t>(threads, block_count));
+
+  // Only a bounded number of blocks may wait for the sink.
+  const std::size_t window = static_cast<std::size_t>(threads) * 2;
+  std::vector<Block> blocks(block_count);
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::size_t next_block = 0;
+  std::size_t next_emit = 0;
+  bool aborted = false;
+  std::exception_ptr error;
+
+  StatePool& pool = GetStatePool();
+
+  auto compress_block = [&](WorkerState& state, std::size_t index) {
+    std::vector<char>& buffer = state.buffer;
+    const std::size_t start = index * kBlockSize;
+    const std::size_t end = std::min(start + kBlockSize, reader.size());
+    const std::size_t dictionary_start =
+        start - std::min(start, kDictionarySize);
+    buffer.resize(end - dictionary_start);
+    reader.Copy(dictionary_start, end - dictionary_start, buffer.data());
+
+    Block& block = blocks[index];
+    block.data = pool.AcquireOutput();
+    state.deflater.CompressBlock(buffer, start - dictionary_start,
+                                 index + 1 == block_count, block.data);
+    block.size = end - start;
+    block.adler =
+        adler32(1L, reinterpret_cast<const Bytef*>(buffer.data()) +
+                        (start - dictionary_start),
+                static_cast<uInt>(block.size));
+  };
+
+  auto worker = [&]() {
+    try {
+      std::unique_ptr<WorkerState> state = pool.AcquireState(level_);
+      for (;;) {
+        std::size_t index;
+        {
+          std::unique_lock<std::mutex> lock{mutex};
+          cv.wait(lock, [&] {
+            return aborted || next_block >= block_count ||
+                   next_block < next_emit + window;
+          });
+          if (aborted || next_block >= block_count) break;
+          index = next_block++;
+        }
+
+        compress_block(*state, index);
+
+        std::lock_guard<std::mutex> lock{mutex};
+        blocks[index].ready = true;
+        cv.notify_all();
+      }
+      pool.ReleaseState(std::move(state));
+    } catch (...) {
+      std::lock_guard<std::mutex> lock{mutex};
+      if (!error) error = std::current_exception();
+      aborted = true;
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  std::unique_ptr<WorkerState> inline_state;
+  if (threads > 1) {
+    for (unsigned int i = 0; i < threads; i++) workers.emplace_back(worker);
+  } else {
+    inline_state = pool.AcquireState(level_);
+  }
+
+  auto join_workers = [&]() {
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      aborted = true;
+      cv.notify_all();
+    }
+    for (auto& thread : workers) thread.join();
+  };
+
+  try {
+    const std::uint16_t header = ZlibHeader();
+    const char header_bytes[2]{static_cast<char>(header >> 8),
+                               static_cast<char>(header & 0xff)};
+    sink(std::string_view{header_bytes, sizeof(header_bytes)});
+
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (std::size_t index = 0; index < block_count; index++) {
+      if (inline_state) {
+        compress_block(*inline_state, index);
+      } else {
+        std::unique_lock<std::mutex> lock{mutex};
+        cv.wait(lock, [&] { return blocks[index].ready || aborted; });
+        if (!blocks[index].ready) std::rethrow_exception(error);
+      }
+
+      Block& block = blocks[index];
+      sink(block.data);
+      adler = adler32_combine(adler, block.adler,
+                              static_cast<z_off_t>(block.size));
+      pool.ReleaseOutput(std::move(block.data));
+
+      std::lock_guard<std::mutex> lock{mutex};
+      next_emit = index + 1;
+      cv.notify_all();
+    }
+
+    const char trailer[4]{static_cast<char>((adler >> 24) & 0xff),
+                          static_cast<char>((adler >> 16) & 0xff),
+                          static_cast<char>((adler >> 8) & 0xff),
+                          static_cast<char>(adler & 0xff)};
+    sink(std::string_view{trailer, sizeof(trailer)});
+  } catch (...) {
+    join_workers();
+    throw;
+  }
+  join_workers();
+  if (inline_state) pool.ReleaseState(std::move(inline_state));
+}
+
+std::uint16_t ParallelDeflate::ZlibHeader() const noexcept {
+  // Same header as deflateInit2 would write for this level.
+  int level_flags;
+  if (level_ == Z_DEFAULT_COMPRESSION || level_ == 6) {
+    level_flags = 2;
+  } else if (level_ < 2) {
+    level_flags = 0;
+  } else if (level_ < 6) {
+    level_flags = 1;
+  } else {
+    level_flags = 3;
+  }
+
+  std::uint16_t header = static_cast<std::uint16_t>(
+      ((Z_DEFLATED + ((kWindowBits - 8) << 4)) << 8) | (level_flags << 6));
+  header += 31 - (header % 31);
+  return header;
+}
+
+}  // namespace saptapper
@@ -0,0 +1,53 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_PARALLEL_DEFLATE_HPP_
+#define SAPTAPPER_PARALLEL_DEFLATE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+#include <zlib.h>
+
+namespace saptapper {
+
+/// Block-parallel zlib compressor in the manner of pigz.
+///
+/// The input is split into fixed-size blocks that are deflated independently,
+/// each primed with the preceding 32 KiB as a dictionary, and joined into a
+/// single zlib stream. Block boundaries never depend on the number of
+/// threads, so the output is identical for any thread count.
+class ParallelDeflate {
+ public:
+  using Sink = std::function<void(std::string_view)>;
+
+  static constexpr std::size_t kBlockSize = 128 * 1024;
+  static constexpr std::size_t kDictionarySize = 32 * 1024;
+
+  explicit ParallelDeflate(int level = Z_BEST_COMPRESSION,
+                           unsigned int threads = 0)
+      : level_{level}, threads_{threads} {}
+
+  int level() const noexcept { return level_; }
+
+  /// The number of worker threads (0 means the number of CPUs).
+  unsigned int threads() const noexcept { return threads_; }
+
+  void set_threads(unsigned int threads) noexcept { threads_ = threads; }
+
+  /// Compresses the concatenation of the input segments. The compressed
+  /// stream is passed to the sink in order, one chunk at a time.
+  void Compress(const std::vector<std::string_view>& input,
+                const Sink& sink) const;
+
+ private:
+  int level_;
+  unsigned int threads_;
+
+  std::uint16_t ZlibHeader() const noexcept;
+};
+
+}  // namespace saptapper
+
+#endif
@@ -0,0 +1,75 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "patched_rom_view.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "bytes.hpp"
+
+namespace saptapper {
+
+void PatchedRomView::Write(size_type offset, std::string_view data) {
+  if (offset > base_.size() || data.size() > base_.size() - offset)
+    throw std::out_of_range("The patch is out of range.");
+  if (data.empty()) return;
+
+  const auto end = static_cast<size_type>(offset + data.size());
+
+  // Merge the new patch with every patch that overlaps or touches it.
+  auto first = std::find_if(patches_.begin(), patches_.end(),
+                            [&](const Patch& p) { return p.end() >= offset; });
+  auto last = std::find_if(first, patches_.end(),
+                           [&](const Patch& p) { return p.offset > end; });
+
+  Patch merged;
+  merged.offset = offset;
+  size_type merged_end = end;
+  if (first != last) {
+    merged.offset = std::min(offset, first->offset);
+    merged_end = std::max(end, std::prev(last)->end());
+  }
+
+  merged.data.assign(base_.substr(merged.offset, merged_end - merged.offset));
+  for (auto it = first; it != last; ++it)
+    merged.data.replace(it->offset - merged.offset, it->data.size(), it->data);
+  merged.data.replace(offset - merged.offset, data.size(), data);
+
+  const auto position = patches_.erase(first, last);
+  patches_.insert(position, std::move(merged));
+}
+
+void PatchedRomView::WriteInt32L(size_type offset, std::uint32_t value) {
+  char bytes[4];
+  saptapper::WriteInt32L(bytes, value);
+  Write(offset, std::string_view{bytes, sizeof(bytes)});
+}
+
+char PatchedRomView::at(size_type offset) const {
+  for (const auto& patch : patches_) {
+    if (offset < patch.offset) break;
+    if (offset < patch.end()) return patch.data[offset - patch.offset];
+  }
+  return base_.at(offset);
+}
+
+std::vector<std::string_view> PatchedRomView::segments() const {
+  std::vector<std::string_view> pieces;
+  pieces.reserve(patches_.size() * 2 + 1);
+
+  size_type pos = 0;
+  for (const auto& patch : patches_) {
+    if (patch.offset > pos)
+      pieces.push_back(base_.substr(pos, patch.offset - pos));
+    pieces.push_back(patch.data);
+    pos = patch.end();
+  }
+  if (pos < base_.size()) pieces.push_back(base_.substr(pos));
+  return pieces;
+}
+
+}  // namespace saptapper
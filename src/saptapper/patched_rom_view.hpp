@@ -0,0 +1,61 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_PATCHED_ROM_VIEW_HPP_
+#define SAPTAPPER_PATCHED_ROM_VIEW_HPP_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+
+namespace saptapper {
+
+/// Read-only ROM image with a few small patches laid over it.
+///
+/// The base image is never modified or copied, so it may be shared (e.g. a
+/// read-only mapped file) while each view carries its own patches.
+class PatchedRomView {
+ public:
+  using size_type = agbsize_t;
+
+  PatchedRomView() = default;
+
+  explicit PatchedRomView(std::string_view base) : base_(base) {}
+
+  std::string_view base() const noexcept { return base_; }
+
+  size_type size() const noexcept {
+    return static_cast<size_type>(base_.size());
+  }
+
+  /// Overwrites the bytes at the offset. The range must lie within the base.
+  void Write(size_type offset, std::string_view data);
+
+  void WriteInt32L(size_type offset, std::uint32_t value);
+
+  char at(size_type offset) const;
+
+  /// The patched image as consecutive pieces of the base and the patches.
+  /// The pieces refer to this view and the base, which must outlive them.
+  std::vector<std::string_view> segments() const;
+
+ private:
+  struct Patch {
+    size_type offset;
+    std::string data;
+
+    size_type end() const noexcept {
+      return offset + static_cast<size_type>(data.size());
+    }
+  };
+
+  std::string_view base_;
+
+  /// Patches sorted by offset. They never overlap or touch each other.
+  std::vector<Patch> patches_;
+};
+
+}  // namespace saptapper
+
+#endif
@@ -5,14 +5,51 @@
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <zlib.h>
 #include "bytes.hpp"
+#include "parallel_deflate.hpp"
 
 namespace saptapper {
 
+namespace {
+
+// The idle writers of the thread. A few are enough, as leases are short.
+constexpr std::size_t kMaximumIdleWriters = 4;
+thread_local std::vector<std::unique_ptr<PsfWriter>> idle_writers;
+
+}  // namespace
+
+PsfWriter::Lease::Lease(uint8_t version) {
+  if (idle_writers.empty()) {
+    writer_ = std::make_unique<PsfWriter>(version);
+  } else {
+    writer_ = std::move(idle_writers.back());
+    idle_writers.pop_back();
+    writer_->version_ = version;
+  }
+}
+
+PsfWriter::Lease::~Lease() {
+  if (idle_writers.size() >= kMaximumIdleWriters) return;
+  writer_->Reset();
+  idle_writers.push_back(std::move(writer_));
+}
+
 PsfWriter::PsfWriter(uint8_t version, std::map<std::string, std::string> tags)
-    : version_{version},
-      exe_{compressed_exe_, zstr::default_buff_size, Z_BEST_COMPRESSION, 15},
-      tags_(std::move(tags)) {}
+    : version_{version}, tags_(std::move(tags)) {}
+
+void PsfWriter::Reset() {
+  reserved_.str(std::string{});
+  reserved_.clear();
+  exe_.clear();
+  tags_.clear();
+  threads_ = 0;
+  compressed_exe_.clear();
+}
 
 void PsfWriter::SaveToFile(const std::filesystem::path& path,
                            const std::map<std::string, std::string>& tags) {
@@ -24,44 +61,92 @@ void PsfWriter::SaveToFile(const std::filesystem::path& path,
 
 void PsfWriter::SaveToStream(std::ostream& out,
                              const std::map<std::string, std::string>& tags) {
-  exe_.flush();
   reserved_.flush();
-
-  const std::string compressed_exe = compressed_exe_.str();
   const std::string reserved = reserved_.str();
-  const std::uint32_t compressed_exe_crc32 =
-      crc32(0L, reinterpret_cast<const Bytef*>(compressed_exe.data()),
-            static_cast<uInt>(compressed_exe.size()));
 
+  const std::ostream::pos_type header_pos = out.tellp();
+  if (header_pos != std::ostream::pos_type(-1)) {
+    SaveSeekable(out, reserved, header_pos);
+  } else {
+    SaveBuffered(out, reserved);
+  }
+
+  WriteTags(out, tags);
+}
+
+void PsfWriter::SaveSeekable(std::ostream& out, std::string_view reserved,
+                             std::ostream::pos_type header_pos) {
+  // Reserve the header, stream the exe as it is compressed, then go back
+  // and fill in the header.
+  const std::string placeholder(kHeaderSize, 0);
+  out.write(placeholder.data(), placeholder.size());
+  out.write(reserved.data(), reserved.size());
+
+  std::uint32_t compressed_exe_size = 0;
+  std::uint32_t compressed_exe_crc32 = crc32(0L, Z_NULL, 0);
+  const ParallelDeflate deflate{Z_BEST_COMPRESSION, threads_};
+  deflate.Compress(exe_, [&](std::string_view chunk) {
+    out.write(chunk.data(), chunk.size());
+    compressed_exe_size += static_cast<std::uint32_t>(chunk.size());
+    compressed_exe_crc32 = crc32(compressed_exe_crc32,
+                                 reinterpret_cast<const Bytef*>(chunk.data()),
+                                 static_cast<uInt>(chunk.size()));
+  });
+
+  const std::ostream::pos_type end_pos = out.tellp();
   const std::string header{
-      NewHeader(compressed_exe, reserved, compressed_exe_crc32)};
+      NewHeader(static_cast<std::uint32_t>(reserved.size()),
+                compressed_exe_size, compressed_exe_crc32)};
+  out.seekp(header_pos);
+  out.write(header.data(), header.size());
+  out.seekp(end_pos);
+}
+
+void PsfWriter::SaveBuffered(std::ostream& out, std::string_view reserved) {
+  std::string& compressed_exe = compressed_exe_;
+  compressed_exe.clear();
+  std::uint32_t compressed_exe_crc32 = crc32(0L, Z_NULL, 0);
+  const ParallelDeflate deflate{Z_BEST_COMPRESSION, threads_};
+  deflate.Compress(exe_, [&](std::string_view chunk) {
+    compressed_exe.append(chunk);
+    compressed_exe_crc32 = crc32(compressed_exe_crc32,
+                                 reinterpret_cast<const Bytef*>(chunk.data()),
+                                 static_cast<uInt>(chunk.size()));
+  });
+
+  const std::string header{NewHeader(
+      static_cast<std::uint32_t>(reserved.size()),
+      static_cast<std::uint32_t>(compressed_exe.size()), compressed_exe_crc32)};
   out.write(header.data(), header.size());
   out.write(reserved.data(), reserved.size());
   out.write(compressed_exe.data(), compressed_exe.size());
+}
+
+void PsfWriter::WriteTags(std::ostream& out,
+                          const std::map<std::string, std::string>& tags) {
+  if (tags.empty()) return;
 
-  if (!tags.empty()) {
-    out.write("[TAG]", 5);
+  out.write("[TAG]", 5);
 
-    for (const auto& tag : tags) {
-      const auto& key = tag.first;
-      const auto& value = tag.second;
+  for (const auto& tag : tags) {
+    const auto& key = tag.first;
+    const auto& value = tag.second;
 
-      std::istringstream value_reader{value};
-      std::string line;
-      while (std::getline(value_reader, line))
-        out << key << '=' << value << '\n';
-    }
+    std::istringstream value_reader{value};
+    std::string line;
+    while (std::getline(value_reader, line))
+      out << key << '=' << value << '\n';
   }
 }
 
-std::string PsfWriter::NewHeader(std::string_view compressed_exe,
-                                 std::string_view reserved,
+std::string PsfWriter::NewHeader(std::uint32_t reserved_size,
+                                 std::uint32_t compressed_exe_size,
                                  std::uint32_t compressed_exe_crc32) const {
-  std::string header(16, 0);
+  std::string header(kHeaderSize, 0);
   std::memcpy(header.data(), "PSF", 3);
   WriteInt8(&header[3], version_);
-  WriteInt32L(&header[4], static_cast<std::uint32_t>(reserved.size()));
-  WriteInt32L(&header[8], static_cast<std::uint32_t>(compressed_exe.size()));
+  WriteInt32L(&header[4], reserved_size);
+  WriteInt32L(&header[8], compressed_exe_size);
   WriteInt32L(&header[12], compressed_exe_crc32);
   return header;
 }
@@ -3,25 +3,58 @@
 #ifndef SAPTAPPER_PSF_WRITER_HPP_
 #define SAPTAPPER_PSF_WRITER_HPP_
 
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <string_view>
-#include "zstr.hpp"
+#include <vector>
 
 namespace saptapper {
 
 class PsfWriter {
  public:
+  /// A writer taken from a pool of the calling thread. The writer is reset
+  /// and goes back to the pool when the lease ends, so that its buffers are
+  /// reused by the next file.
+  class Lease {
+   public:
+    explicit Lease(uint8_t version);
+    ~Lease();
+
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+
+    PsfWriter& operator*() const noexcept { return *writer_; }
+    PsfWriter* operator->() const noexcept { return writer_.get(); }
+
+   private:
+    std::unique_ptr<PsfWriter> writer_;
+  };
+
   PsfWriter(uint8_t version, std::map<std::string, std::string> tags = {});
 
   uint8_t version() const noexcept { return version_; }
-  std::ostream& exe() noexcept { return exe_; }
+  const std::vector<std::string_view>& exe() const noexcept { return exe_; }
   std::ostream& reserved() noexcept { return reserved_; }
   std::map<std::string, std::string>& tags() noexcept { return tags_; }
 
+  /// The number of compression threads (0 means the number of CPUs).
+  unsigned int threads() const noexcept { return threads_; }
+
+  void set_threads(unsigned int threads) noexcept { threads_ = threads; }
+
+  /// Returns the writer to its newly constructed state, keeping the version
+  /// and the memory it has allocated.
+  void Reset();
+
+  /// Appends data to the uncompressed exe. The data is not copied, so it must
+  /// stay alive until the file is saved.
+  void AppendExe(std::string_view data) { exe_.push_back(data); }
+
   void SaveToFile(const std::filesystem::path& path) {
     SaveToFile(path, tags_);
   }
@@ -31,18 +64,34 @@ class PsfWriter {
 
   void SaveToStream(std::ostream& out) { SaveToStream(out, tags_); }
 
+  /// Writes the PSF file. On a seekable stream the compressed exe is written
+  /// as it is produced and the header is filled in afterwards; otherwise the
+  /// compressed exe is buffered first.
   void SaveToStream(std::ostream& out,
                     const std::map<std::string, std::string>& tags);
 
+  /// Writes the tag section that follows the exe.
+  static void WriteTags(std::ostream& out,
+                        const std::map<std::string, std::string>& tags);
+
  private:
+  static constexpr std::size_t kHeaderSize = 16;
+
   uint8_t version_;
   std::ostringstream reserved_;
-  std::ostringstream compressed_exe_;
-  zstr::ostream exe_;
+  std::vector<std::string_view> exe_;
   std::map<std::string, std::string> tags_;
+  unsigned int threads_ = 0;
+
+  /// The compressed exe, for streams that cannot seek.
+  std::string compressed_exe_;
+
+  void SaveSeekable(std::ostream& out, std::string_view reserved,
+                    std::ostream::pos_type header_pos);
+  void SaveBuffered(std::ostream& out, std::string_view reserved);
 
-  std::string NewHeader(std::string_view compressed_exe,
-                        std::string_view reserved,
+  std::string NewHeader(std::uint32_t reserved_size,
+                        std::uint32_t compressed_exe_size,
                         std::uint32_t compressed_exe_crc32) const;
 };
 
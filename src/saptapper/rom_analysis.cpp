@@ -0,0 +1,40 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "rom_analysis.hpp"
+
+#include <algorithm>
+#include <string_view>
+#include "call_graph_index.hpp"
+#include "free_space_index.hpp"
+#include "rom_pointer_index.hpp"
+#include "signature_scanner.hpp"
+
+namespace saptapper {
+
+RomAnalysis RomAnalysis::Analyze(std::string_view rom,
+                                 const SignatureScanner& scanner) {
+  RomAnalysis analysis;
+  analysis.rom_size_ = rom.size();
+  analysis.signature_hits_ = scanner.NewHits();
+
+  FreeSpaceIndex::Builder ff_builder{'\xff'};
+  FreeSpaceIndex::Builder zero_builder{'\0'};
+  RomPointerIndex::Builder pointer_builder;
+  CallGraphIndex::Builder call_builder;
+  for (std::size_t begin = 0; begin < rom.size(); begin += kTileSize) {
+    const std::size_t end = std::min(rom.size(), begin + kTileSize);
+    scanner.Scan(rom, static_cast<agbsize_t>(begin),
+                 static_cast<agbsize_t>(end), analysis.signature_hits_);
+    ff_builder.Feed(rom, end);
+    zero_builder.Feed(rom, end);
+    pointer_builder.Feed(rom, end);
+    call_builder.Feed(rom, end);
+  }
+  analysis.ff_space_ = ff_builder.Finish(rom);
+  analysis.zero_space_ = zero_builder.Finish(rom);
+  analysis.pointers_ = pointer_builder.Finish(rom);
+  analysis.calls_ = call_builder.Finish(rom);
+  return analysis;
+}
+
+}  // namespace saptapper
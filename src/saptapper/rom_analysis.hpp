@@ -0,0 +1,58 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_ROM_ANALYSIS_HPP_
+#define SAPTAPPER_ROM_ANALYSIS_HPP_
+
+#include <cstddef>
+#include <string_view>
+#include "call_graph_index.hpp"
+#include "free_space_index.hpp"
+#include "rom_pointer_index.hpp"
+#include "signature_scanner.hpp"
+#include "types.hpp"
+
+namespace saptapper {
+
+/// Facts about a ROM image collected in a single pass over it.
+///
+/// The image is streamed in tiles that fit in the L2 cache. While a tile is
+/// hot, it is scanned for signatures, free space, pointers and calls, so the
+/// later phases of a rip need not read the whole image again.
+class RomAnalysis {
+ public:
+  static constexpr std::size_t kTileSize = 256 * 1024;
+
+  RomAnalysis() = default;
+
+  static RomAnalysis Analyze(std::string_view rom,
+                             const SignatureScanner& scanner);
+
+  std::size_t rom_size() const noexcept { return rom_size_; }
+
+  const SignatureScanner::Hits& signature_hits() const noexcept {
+    return signature_hits_;
+  }
+
+  /// The runs of filler bytes (0xFF or 0x00).
+  const FreeSpaceIndex& free_space(char filler) const {
+    return filler == '\0' ? zero_space_ : ff_space_;
+  }
+
+  /// The words that look like ROM pointers.
+  const RomPointerIndex& pointers() const noexcept { return pointers_; }
+
+  /// The direct calls.
+  const CallGraphIndex& calls() const noexcept { return calls_; }
+
+ private:
+  std::size_t rom_size_ = 0;
+  SignatureScanner::Hits signature_hits_;
+  FreeSpaceIndex ff_space_;
+  FreeSpaceIndex zero_space_;
+  RomPointerIndex pointers_;
+  CallGraphIndex calls_;
+};
+
+}  // namespace saptapper
+
+#endif
@@ -0,0 +1,125 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "rom_pointer_index.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "bytes.hpp"
+#include "cpu_features.hpp"
+#include "types.hpp"
+
+#ifdef SAPTAPPER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace saptapper {
+
+namespace {
+
+constexpr std::size_t kAlign = 4;
+
+// The number of bytes covered by a ROM address.
+constexpr std::uint32_t kRomAddressSpace = 0x2000000;
+
+}  // namespace
+
+void RomPointerIndex::Builder::Feed(std::string_view rom, std::size_t end) {
+  end = std::min(end, rom.size());
+  const std::size_t word_count = end / kAlign;
+  romptr_bits_.resize((word_count + 31) / 32);
+  pointer_bits_.resize(romptr_bits_.size());
+
+  const std::uint32_t limit = static_cast<std::uint32_t>(
+      std::min<std::size_t>(rom.size(), kRomAddressSpace));
+
+  std::size_t pos = cursor_;
+  auto record_word = [&](std::size_t word_pos) {
+    const agbptr_t word = ReadInt32L(&rom[word_pos]);
+    if (is_romptr(word))
+      Record(rom, word_pos, 1, to_offset(word) < limit ? 1 : 0);
+  };
+#ifdef SAPTAPPER_SSE2
+  for (; pos % 16 != 0 && pos + kAlign <= end; pos += kAlign) record_word(pos);
+
+  // Four words at a time: a word is a ROM address if its top 7 bits are
+  // 0000100, and points into the image if its low 25 bits are below limit.
+  const __m128i romptr_tag = _mm_set1_epi32(0x8000000 >> 25);
+  const __m128i offset_mask = _mm_set1_epi32(kRomAddressSpace - 1);
+  const __m128i limits = _mm_set1_epi32(static_cast<int>(limit));
+  while (pos + 16 <= end) {
+    const __m128i words =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rom.data() + pos));
+    const __m128i romptr =
+        _mm_cmpeq_epi32(_mm_srli_epi32(words, 25), romptr_tag);
+    const __m128i inside =
+        _mm_cmplt_epi32(_mm_and_si128(words, offset_mask), limits);
+    const auto romptr_mask = static_cast<std::uint32_t>(
+        _mm_movemask_ps(_mm_castsi128_ps(romptr)));
+    if (romptr_mask != 0) {
+      const auto pointer_mask =
+          romptr_mask & static_cast<std::uint32_t>(
+                            _mm_movemask_ps(_mm_castsi128_ps(inside)));
+      Record(rom, pos, romptr_mask, pointer_mask);
+    }
+    pos += 16;
+  }
+#endif
+  for (; pos + kAlign <= end; pos += kAlign) record_word(pos);
+  cursor_ = pos;
+}
+
+void RomPointerIndex::Builder::Record(std::string_view rom, std::size_t pos,
+                                      std::uint32_t romptr,
+                                      std::uint32_t pointer) {
+  const std::size_t word = pos / kAlign;
+  // Several words are only recorded at once from a 16-byte-aligned pos, so
+  // their bits never straddle two bitmap words.
+  romptr_bits_[word / 32] |= romptr << (word % 32);
+  pointer_bits_[word / 32] |= pointer << (word % 32);
+  while (pointer != 0) {
+    const std::size_t source = pos + kAlign * count_trailing_zeros(pointer);
+    const std::uint64_t target = to_offset(ReadInt32L(&rom[source]));
+    references_.push_back((target << 32) | source);
+    pointer &= pointer - 1;
+  }
+}
+
+RomPointerIndex RomPointerIndex::Builder::Finish(std::string_view rom) {
+  Feed(rom, rom.size());
+
+  RomPointerIndex index;
+  index.romptr_bits_ = std::move(romptr_bits_);
+  index.pointer_bits_ = std::move(pointer_bits_);
+  index.references_ = std::move(references_);
+  std::sort(index.references_.begin(), index.references_.end());
+  return index;
+}
+
+RomPointerIndex RomPointerIndex::Build(std::string_view rom) {
+  Builder builder;
+  return builder.Finish(rom);
+}
+
+bool RomPointerIndex::IsReferenced(agbsize_t target) const {
+  const std::uint64_t first = static_cast<std::uint64_t>(target) << 32;
+  const auto it =
+      std::lower_bound(references_.begin(), references_.end(), first);
+  return it != references_.end() && (*it >> 32) == target;
+}
+
+std::vector<agbsize_t> RomPointerIndex::FindReferences(
+    agbsize_t target) const {
+  const std::uint64_t first = static_cast<std::uint64_t>(target) << 32;
+  std::vector<agbsize_t> sources;
+  for (auto it = std::lower_bound(references_.begin(), references_.end(),
+                                  first);
+       it != references_.end() && (*it >> 32) == target; ++it) {
+    sources.push_back(static_cast<agbsize_t>(*it));
+  }
+  return sources;
+}
+
+}  // namespace saptapper
@@ -0,0 +1,80 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_ROM_POINTER_INDEX_HPP_
+#define SAPTAPPER_ROM_POINTER_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+
+namespace saptapper {
+
+/// Index of the 4-byte-aligned words of a ROM image that look like ROM
+/// pointers, such as the entries of literal pools and pointer tables.
+///
+/// A bitmap tells whether the word at an offset is a ROM address, and the
+/// words that point into the image are also kept sorted by their target, so
+/// that the references to an address are found in O(log n).
+class RomPointerIndex {
+ public:
+  /// Records the pointers while a ROM image is streamed through it in order.
+  class Builder {
+   public:
+    Builder() = default;
+
+    /// Advances through the words of the ROM before end.
+    void Feed(std::string_view rom, std::size_t end);
+
+    RomPointerIndex Finish(std::string_view rom);
+
+   private:
+    std::vector<std::uint32_t> romptr_bits_;
+    std::vector<std::uint32_t> pointer_bits_;
+    std::vector<std::uint64_t> references_;
+    std::size_t cursor_ = 0;
+
+    void Record(std::string_view rom, std::size_t pos, std::uint32_t romptr,
+                std::uint32_t pointer);
+  };
+
+  RomPointerIndex() = default;
+
+  static RomPointerIndex Build(std::string_view rom);
+
+  /// Whether the aligned word at offset is a ROM address (see is_romptr).
+  bool IsRomPointer(agbsize_t offset) const noexcept {
+    return TestBit(romptr_bits_, offset);
+  }
+
+  /// Whether the aligned word at offset is a ROM address inside the image.
+  bool IsPointer(agbsize_t offset) const noexcept {
+    return TestBit(pointer_bits_, offset);
+  }
+
+  /// Whether any aligned word points to the given offset of the image.
+  bool IsReferenced(agbsize_t target) const;
+
+  /// The offsets of the aligned words that point to the given offset of the
+  /// image, in ascending order.
+  std::vector<agbsize_t> FindReferences(agbsize_t target) const;
+
+ private:
+  std::vector<std::uint32_t> romptr_bits_;
+  std::vector<std::uint32_t> pointer_bits_;
+
+  /// The references, as (target << 32 | source) in ascending order.
+  std::vector<std::uint64_t> references_;
+
+  static bool TestBit(const std::vector<std::uint32_t>& bits,
+                      agbsize_t offset) noexcept {
+    if (offset % 4 != 0) return false;
+    const std::size_t word = offset / 4;
+    return word / 32 < bits.size() && ((bits[word / 32] >> (word % 32)) & 1);
+  }
+};
+
+}  // namespace saptapper
+
+#endif
@@ -5,78 +5,218 @@
 #include <filesystem>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <vector>
 #include "cartridge.hpp"
+#include "content_hash.hpp"
+#include "convert_options.hpp"
 #include "gsf_header.hpp"
 #include "gsf_writer.hpp"
+#include "gsflib_store.hpp"
+#include "inspection_cache.hpp"
+#include "known_games.hpp"
 #include "minigsf_driver_param.hpp"
 #include "mp2k_driver.hpp"
 #include "mp2k_driver_param.hpp"
+#include "output_sink.hpp"
+#include "free_space_index.hpp"
+#include "patched_rom_view.hpp"
+#include "rom_analysis.hpp"
+#include "zip_output_sink.hpp"
 
 namespace saptapper {
 
-void Saptapper::ConvertToGsfSet(Cartridge& cartridge,
-                                const std::filesystem::path& basename,
-                                const std::filesystem::path& outdir,
-                                const std::string_view& gsfby,
-                                bool keep_duplicated) {
+int Saptapper::ConvertToGsfSet(const Cartridge& cartridge,
+                               const std::filesystem::path& basename,
+                               const std::filesystem::path& outdir,
+                               const ConvertOptions& options) {
+  std::filesystem::path base_path{outdir};
+  base_path /= basename;
+  const std::unique_ptr<OutputSink> sink{NewOutputSink(base_path, options)};
+  const int saved_count =
+      ConvertToGsfSet(cartridge, base_path.filename(), *sink, options);
+  sink->Close();
+  return saved_count;
+}
+
+int Saptapper::ConvertToGsfSet(const Cartridge& cartridge,
+                               const std::filesystem::path& basename,
+                               OutputSink& sink,
+                               const ConvertOptions& options) {
   Mp2kDriverParam param;
   MinigsfDriverParam minigsf;
   agbptr_t gsf_driver_addr = agbnullptr;
-  Inspect(cartridge, param, minigsf, gsf_driver_addr, true);
+  Inspect(cartridge, InspectionCache{options.cache_dir()}, param, minigsf,
+          gsf_driver_addr, true);
+  return SaveGsfSet(cartridge, param, minigsf, gsf_driver_addr, basename, sink,
+                    options);
+}
 
-  Mp2kDriver::InstallGsfDriver(cartridge.rom(), gsf_driver_addr, param);
+int Saptapper::SaveGsfSet(const Cartridge& cartridge,
+                          const Mp2kDriverParam& param,
+                          const MinigsfDriverParam& minigsf,
+                          agbptr_t gsf_driver_addr,
+                          const std::filesystem::path& basename,
+                          OutputSink& sink, const ConvertOptions& options) {
+  const PatchedRomView patched_rom =
+      Mp2kDriver::InstallGsfDriver(cartridge.rom(), gsf_driver_addr, param);
 
-  std::filesystem::path base_path{outdir};
-  base_path /= basename;
-  create_directories(base_path.parent_path());
-
-  std::filesystem::path gsflib_path{base_path};
-  gsflib_path += ".gsflib";
+  const std::string base_name{basename.generic_u8string()};
+  const std::string gsflib_name{base_name + ".gsflib"};
 
   const agbptr_t entrypoint = 0x8000000;
   const GsfHeader gsf_header{entrypoint, entrypoint, cartridge.size()};
-  GsfWriter::SaveToFile(gsflib_path, gsf_header, cartridge.rom());
+  const unsigned int threads = options.compression_threads();
+  const auto save_gsflib = [&](std::ostream& out) {
+    GsfWriter::SaveToStream(out, gsf_header, patched_rom, {}, threads);
+  };
+
+  const GsflibStore store{options.gsflib_store()};
+  std::filesystem::path stored_gsflib;
+  if (store.enabled()) {
+    const std::uint64_t key = GsfWriter::HashGsflib(gsf_header, patched_rom);
+    stored_gsflib = store.Find(key);
+    if (stored_gsflib.empty()) stored_gsflib = store.Add(key, save_gsflib);
+  }
+  if (!stored_gsflib.empty()) {
+    sink.CopyEntry(gsflib_name, stored_gsflib);
+  } else {
+    GsfWriter::SaveToSink(sink, gsflib_name, gsf_header, patched_rom, {},
+                          threads);
+  }
 
-  const std::string lib{gsflib_path.filename().string()};
+  const std::string lib{basename.filename().u8string() + ".gsflib"};
   std::map<std::string, std::string> minigsf_tags{{"_lib", lib}};
-  if (!gsfby.empty()) minigsf_tags["gsfby"] = gsfby;
+  if (!options.gsfby().empty()) minigsf_tags["gsfby"] = options.gsfby();
+
+  std::vector<int> origins;
+  if (!options.keep_duplicated()) {
+    const auto build_map = options.content_dedup()
+                               ? Mp2kDriver::BuildContentDuplicateMap
+                               : Mp2kDriver::BuildDuplicateMap;
+    origins =
+        build_map(cartridge.rom(), param.song_table(), param.song_count());
+  }
 
+  const GsfWriter::MinigsfTemplate minigsf_template{minigsf};
+  int saved_count = 0;
   for (int song = 0; song < param.song_count(); song++) {
-    if (!keep_duplicated) {
-      int origin = Mp2kDriver::FindIdenticalSong(cartridge.rom(),
-                                                 param.song_table(), song);
-      if (origin != Mp2kDriver::kNoSong) continue;
-    }
+    if (!options.keep_duplicated() && origins[song] != Mp2kDriver::kNoSong)
+      continue;
 
-    SaveMinigsfFile(base_path, minigsf, song, minigsf_tags);
+    SaveMinigsfFile(sink, base_name, minigsf_template, song, minigsf_tags);
+    saved_count++;
   }
+  return saved_count;
+}
+
+std::unique_ptr<OutputSink> Saptapper::NewOutputSink(
+    const std::filesystem::path& base_path, const ConvertOptions& options) {
+  if (!options.zip_output())
+    return std::make_unique<BatchDirectoryOutputSink>(base_path.parent_path());
+
+  std::filesystem::path zip_path{base_path};
+  zip_path += ".zip";
+  if (zip_path.has_parent_path()) create_directories(zip_path.parent_path());
+  return std::make_unique<ZipOutputSink>(zip_path);
 }
 
 void Saptapper::SaveMinigsfFile(
     const std::filesystem::path& base_path, const MinigsfDriverParam& minigsf,
     int song, const std::map<std::string, std::string>& tags) {
-  std::ostringstream songid;
-  songid << std::setfill('0') << std::setw(4) << song;
+  SaveMinigsfFile(base_path, GsfWriter::MinigsfTemplate{minigsf}, song, tags);
+}
+
+void Saptapper::SaveMinigsfFile(
+    const std::filesystem::path& base_path,
+    const GsfWriter::MinigsfTemplate& minigsf, int song,
+    const std::map<std::string, std::string>& tags) {
+  DirectoryOutputSink sink{base_path.parent_path()};
+  SaveMinigsfFile(sink, base_path.filename().u8string(), minigsf, song, tags);
+}
+
+void Saptapper::SaveMinigsfFile(
+    OutputSink& sink, const std::string& basename,
+    const MinigsfDriverParam& minigsf, int song,
+    const std::map<std::string, std::string>& tags) {
+  SaveMinigsfFile(sink, basename, GsfWriter::MinigsfTemplate{minigsf}, song,
+                  tags);
+}
 
-  std::filesystem::path minigsf_path{base_path};
-  minigsf_path += "-";
-  minigsf_path += songid.str();
-  minigsf_path += ".minigsf";
+void Saptapper::SaveMinigsfFile(
+    OutputSink& sink, const std::string& basename,
+    const GsfWriter::MinigsfTemplate& minigsf, int song,
+    const std::map<std::string, std::string>& tags) {
+  GsfWriter::SaveMinigsfToSink(sink, GetMinigsfName(basename, song), minigsf,
+                               song, tags);
+}
 
-  GsfWriter::SaveMinigsfToFile(minigsf_path, minigsf, song, tags);
+std::string Saptapper::GetMinigsfName(const std::string& basename, int song) {
+  std::ostringstream name;
+  name << basename << "-" << std::setfill('0') << std::setw(4) << song
+       << ".minigsf";
+  return name.str();
 }
 
 void Saptapper::Inspect(const Cartridge& cartridge, Mp2kDriverParam& param,
                         MinigsfDriverParam& minigsf, agbptr_t& gsf_driver_addr,
                         bool throw_if_missing) {
+  Inspect(cartridge, InspectionCache{}, param, minigsf, gsf_driver_addr,
+          throw_if_missing);
+}
+
+void Saptapper::Inspect(const Cartridge& cartridge,
+                        const InspectionCache& cache, Mp2kDriverParam& param,
+                        MinigsfDriverParam& minigsf, agbptr_t& gsf_driver_addr,
+                        bool throw_if_missing) {
+  if (InspectKnownGame(cartridge, param, minigsf, gsf_driver_addr)) return;
+
+  // The cache only records the free space chosen by Inspect itself.
+  const bool use_cache = cache.enabled() && gsf_driver_addr == agbnullptr;
+  std::uint64_t rom_hash = 0;
+  if (use_cache) {
+    // The key is needed before the analysis, which does not hash the ROM, so
+    // a miss still reads the ROM for the hash only once.
+    rom_hash = ContentHash::Compute(cartridge.rom());
+    InspectionCache::Entry entry;
+    // The minigsf follows from the rest of the record, and must agree.
+    if (cache.Find(rom_hash, cartridge.size(), entry) &&
+        Mp2kDriver::Validate(cartridge.rom(), entry.param) &&
+        IsFreeSpace(cartridge.rom(), entry.gsf_driver_addr,
+                    Mp2kDriver::gsf_driver_size()) &&
+        entry.minigsf.address() ==
+            Mp2kDriver::minigsf_address(entry.gsf_driver_addr) &&
+        entry.minigsf.size() == GetMinigsfSize(entry.param.song_count())) {
+      param = entry.param;
+      minigsf = entry.minigsf;
+      gsf_driver_addr = entry.gsf_driver_addr;
+      return;
+    }
+  }
+
+  const RomAnalysis analysis{
+      RomAnalysis::Analyze(cartridge.rom(), Mp2kDriver::scanner())};
+  Inspect(cartridge, analysis, param, minigsf, gsf_driver_addr,
+          throw_if_missing);
+
+  if (use_cache && param.ok() && gsf_driver_addr != agbnullptr)
+    cache.Save(rom_hash, cartridge.size(), {param, minigsf, gsf_driver_addr});
+}
+
+void Saptapper::Inspect(const Cartridge& cartridge,
+                        const RomAnalysis& analysis, Mp2kDriverParam& param,
+                        MinigsfDriverParam& minigsf, agbptr_t& gsf_driver_addr,
+                        bool throw_if_missing) {
   if (gsf_driver_addr != agbnullptr && !is_romptr(gsf_driver_addr))
     throw std::invalid_argument("The gsf driver address is not valid.");
+  if (analysis.rom_size() != cartridge.size())
+    throw std::invalid_argument("The ROM analysis is of another ROM.");
 
-  param = Mp2kDriver::Inspect(cartridge.rom());
+  param = Mp2kDriver::Inspect(cartridge.rom(), analysis);
   if (throw_if_missing && !param.ok()) {
     std::ostringstream message;
     message << "Identification of MusicPlayer2000 driver is incomplete."
@@ -87,8 +227,8 @@ void Saptapper::Inspect(const Cartridge& cartridge, Mp2kDriverParam& param,
   }
 
   if (gsf_driver_addr == agbnullptr)
-    gsf_driver_addr =
-        FindFreeSpace(cartridge.rom(), Mp2kDriver::gsf_driver_size());
+    gsf_driver_addr = FindFreeSpace(cartridge.rom(), analysis,
+                                    Mp2kDriver::gsf_driver_size());
 
   if (throw_if_missing && gsf_driver_addr == agbnullptr) {
     std::ostringstream message;
@@ -101,49 +241,72 @@ void Saptapper::Inspect(const Cartridge& cartridge, Mp2kDriverParam& param,
   minigsf.set_size(GetMinigsfSize(param.song_count()));
 }
 
-void Saptapper::PrintParam(const Mp2kDriverParam& param,
+void Saptapper::PrintParam(std::ostream& stream, const Mp2kDriverParam& param,
                            const MinigsfDriverParam& minigsf) {
-  std::cout << "Status: " << (param.ok() ? "OK" : "FAILED") << std::endl
-            << std::endl;
+  stream << "Status: " << (param.ok() ? "OK" : "FAILED") << std::endl
+         << std::endl;
 
-  (void)param.WriteAsTable(std::cout);
-  std::cout << std::endl;
+  (void)param.WriteAsTable(stream);
+  stream << std::endl;
 
-  std::cout << "minigsf information:" << std::endl << std::endl;
-  (void)minigsf.WriteAsTable(std::cout);
+  stream << "minigsf information:" << std::endl << std::endl;
+  (void)minigsf.WriteAsTable(stream);
 }
 
-agbptr_t Saptapper::FindFreeSpace(std::string_view rom, agbsize_t size,
-                                  char filler, bool largest) {
-  agbptr_t space = agbnullptr;
-  agbsize_t space_size = 0;
-  for (agbsize_t offset = 0; offset < rom.size(); offset += 4) {
-    if (rom[offset] == filler) {
-      agbsize_t end_pos = offset + 1;
-      while (end_pos < rom.size() && rom[end_pos] == filler) end_pos++;
+bool Saptapper::InspectKnownGame(const Cartridge& cartridge,
+                                 Mp2kDriverParam& param,
+                                 MinigsfDriverParam& minigsf,
+                                 agbptr_t& gsf_driver_addr) {
+  if (gsf_driver_addr != agbnullptr && !is_romptr(gsf_driver_addr))
+    return false;
+
+  const KnownGame* game = KnownGames::Find(cartridge.rom());
+  if (game == nullptr) return false;
 
-      const agbsize_t candidate_size = end_pos - offset;
-      if (candidate_size >= size) {
-        if (candidate_size > space_size) {
-          space = to_romptr(offset);
-          space_size = candidate_size;
-          if (!largest) return space;
-        }
-      }
+  const Mp2kDriverParam known_param{game->param()};
+  if (!Mp2kDriver::Validate(cartridge.rom(), known_param)) return false;
 
-      offset = (end_pos + 3) & ~3;
-    }
+  const agbptr_t driver_addr = gsf_driver_addr != agbnullptr
+                                   ? gsf_driver_addr
+                                   : game->gsf_driver_addr;
+  if (gsf_driver_addr == agbnullptr &&
+      !IsFreeSpace(cartridge.rom(), driver_addr,
+                   Mp2kDriver::gsf_driver_size())) {
+    return false;
+  }
+
+  param = known_param;
+  gsf_driver_addr = driver_addr;
+  minigsf.set_address(Mp2kDriver::minigsf_address(gsf_driver_addr));
+  minigsf.set_size(GetMinigsfSize(param.song_count()));
+  return true;
+}
+
+bool Saptapper::IsFreeSpace(std::string_view rom, agbptr_t address,
+                            agbsize_t size) {
+  const agbsize_t offset = to_offset(address);
+  if (!is_romptr(address) || offset >= rom.size() ||
+      rom.size() - offset < size) {
+    return false;
   }
-  return space;
+
+  const std::string_view block = rom.substr(offset, size);
+  return block.find_first_not_of('\xff') == std::string_view::npos ||
+         block.find_first_not_of('\0') == std::string_view::npos;
 }
 
-agbptr_t Saptapper::FindFreeSpace(std::string_view rom, agbsize_t size) {
-  constexpr bool largest = false;
-  agbptr_t addr = FindFreeSpace(rom, size, '\xff', largest);
-  if (addr == agbnullptr) {
-    addr = FindFreeSpace(rom, size, 0, largest);
+agbptr_t Saptapper::FindFreeSpace(std::string_view rom,
+                                  const RomAnalysis& analysis,
+                                  agbsize_t size) {
+  for (const char filler : {'\xff', '\0'}) {
+    const FreeSpaceIndex& index = analysis.free_space(filler);
+    const agbsize_t offset =
+        size >= index.minimum_size()
+            ? index.FirstFit(size)
+            : FreeSpaceIndex::Build(rom, filler, size).FirstFit(size);
+    if (offset != agbnpos) return to_romptr(offset);
   }
-  return addr;
+  return agbnullptr;
 }
 
 }  // namespace saptapper
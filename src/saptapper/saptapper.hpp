@@ -4,39 +4,116 @@
 #define SAPTAPPER_SAPTAPPER_HPP_
 
 #include <filesystem>
+#include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 #include <string_view>
 #include "cartridge.hpp"
+#include "convert_options.hpp"
+#include "gsf_writer.hpp"
+#include "inspection_cache.hpp"
 #include "minigsf_driver_param.hpp"
 #include "mp2k_driver_param.hpp"
+#include "output_sink.hpp"
+#include "rom_analysis.hpp"
 #include "types.hpp"
 
 namespace saptapper {
 
 class Saptapper {
  public:
-  static void ConvertToGsfSet(Cartridge& cartridge,
-                              const std::filesystem::path& basename,
-                              const std::filesystem::path& outdir = "",
-                              const std::string_view& gsfby = "",
-                              bool keep_duplicated = false);
+  static int ConvertToGsfSet(const Cartridge& cartridge,
+                             const std::filesystem::path& basename,
+                             const std::filesystem::path& outdir = "",
+                             const ConvertOptions& options = {});
+
+  /// Writes the GSF set into the sink, with entry names starting with
+  /// basename.
+  static int ConvertToGsfSet(const Cartridge& cartridge,
+                             const std::filesystem::path& basename,
+                             OutputSink& sink,
+                             const ConvertOptions& options = {});
+
+  /// Writes the GSF set of an inspected cartridge into the sink (the part of
+  /// ConvertToGsfSet that follows Inspect).
+  static int SaveGsfSet(const Cartridge& cartridge,
+                        const Mp2kDriverParam& param,
+                        const MinigsfDriverParam& minigsf,
+                        agbptr_t gsf_driver_addr,
+                        const std::filesystem::path& basename,
+                        OutputSink& sink, const ConvertOptions& options = {});
+
+  /// Creates the sink that ConvertToGsfSet writes the set at base_path into:
+  /// the directory of base_path, or a ZIP archive named after it. The entries
+  /// are named after the filename of base_path.
+  static std::unique_ptr<OutputSink> NewOutputSink(
+      const std::filesystem::path& base_path, const ConvertOptions& options);
 
   static void SaveMinigsfFile(
       const std::filesystem::path& base_path, const MinigsfDriverParam& minigsf,
       int song, const std::map<std::string, std::string>& tags = {});
 
+  static void SaveMinigsfFile(
+      const std::filesystem::path& base_path,
+      const GsfWriter::MinigsfTemplate& minigsf, int song,
+      const std::map<std::string, std::string>& tags = {});
+
+  /// Writes the minigsf as the entry of the sink that ConvertToGsfSet would
+  /// name after basename.
+  static void SaveMinigsfFile(
+      OutputSink& sink, const std::string& basename,
+      const MinigsfDriverParam& minigsf, int song,
+      const std::map<std::string, std::string>& tags = {});
+
+  static void SaveMinigsfFile(
+      OutputSink& sink, const std::string& basename,
+      const GsfWriter::MinigsfTemplate& minigsf, int song,
+      const std::map<std::string, std::string>& tags = {});
+
+  /// Inspects the cartridge, with the result in known_games.inc if the ROM is
+  /// listed there and the result checks out, or else with the heuristics.
   static void Inspect(const Cartridge& cartridge, Mp2kDriverParam& param,
                       MinigsfDriverParam& minigsf, agbptr_t& gsf_driver_addr,
                       bool throw_if_missing = false);
 
+  /// Like Inspect, but reuses the result recorded in the cache for the same
+  /// ROM image, and records a new successful result there.
+  static void Inspect(const Cartridge& cartridge, const InspectionCache& cache,
+                      Mp2kDriverParam& param, MinigsfDriverParam& minigsf,
+                      agbptr_t& gsf_driver_addr,
+                      bool throw_if_missing = false);
+
+  /// Inspects the cartridge with the heuristics, using the facts already
+  /// collected about it.
+  static void Inspect(const Cartridge& cartridge, const RomAnalysis& analysis,
+                      Mp2kDriverParam& param, MinigsfDriverParam& minigsf,
+                      agbptr_t& gsf_driver_addr,
+                      bool throw_if_missing = false);
+
   static void PrintParam(const Mp2kDriverParam& param,
+                         const MinigsfDriverParam& minigsf) {
+    PrintParam(std::cout, param, minigsf);
+  }
+
+  static void PrintParam(std::ostream& stream, const Mp2kDriverParam& param,
                          const MinigsfDriverParam& minigsf);
 
  private:
-  static agbptr_t FindFreeSpace(std::string_view rom, agbsize_t size);
-  static agbptr_t FindFreeSpace(std::string_view rom, agbsize_t size,
-                                char filler, bool largest);
+  static std::string GetMinigsfName(const std::string& basename, int song);
+
+  static bool InspectKnownGame(const Cartridge& cartridge,
+                               Mp2kDriverParam& param,
+                               MinigsfDriverParam& minigsf,
+                               agbptr_t& gsf_driver_addr);
+
+  // Whether the size bytes at address are all 0xFF or all 0x00.
+  static bool IsFreeSpace(std::string_view rom, agbptr_t address,
+                          agbsize_t size);
+
+  // Finds the first run of 0xFF bytes that fits, or else of 0x00 bytes.
+  static agbptr_t FindFreeSpace(std::string_view rom,
+                                const RomAnalysis& analysis, agbsize_t size);
 
   static constexpr agbsize_t GetMinigsfSize(int song_count) {
     if (song_count <= 0) return 0;
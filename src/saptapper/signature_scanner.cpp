@@ -0,0 +1,169 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "signature_scanner.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "algorithm.hpp"
+#include "byte_pattern.hpp"
+#include "bytes.hpp"
+#include "types.hpp"
+
+namespace saptapper {
+
+namespace {
+
+constexpr agbsize_t kAlign = 4;
+
+// The number of positions scanned at once by Scan(rom).
+constexpr agbsize_t kScanWindow = 0x10000;
+
+// Reads the aligned word at pos. Bytes past the end of the ROM read as zero.
+std::uint32_t ReadWord(std::string_view rom, std::size_t pos) {
+  char word[kAlign]{};
+  std::memcpy(word, rom.data() + pos, std::min<std::size_t>(
+                                          kAlign, rom.size() - pos));
+  return ReadInt32L(word);
+}
+
+// Returns the aligned word of the signature with the most checked bytes.
+WordKey SelectKey(const SignatureScanner::Signature& signature) {
+  WordKey best{0, 0, 0};
+  int best_count = 0;
+  for (std::size_t offset = 0; offset < signature.data.size();
+       offset += kAlign) {
+    WordKey key{static_cast<agbsize_t>(offset), 0, 0};
+    int count = 0;
+    for (std::size_t i = 0; i < kAlign && offset + i < signature.data.size();
+         i++) {
+      if (!signature.mask.empty() && signature.mask[offset + i] == '?')
+        continue;
+      key.value |= static_cast<std::uint32_t>(static_cast<unsigned char>(
+                       signature.data[offset + i]))
+                   << (8 * i);
+      key.mask |= 0xffu << (8 * i);
+      count++;
+    }
+    if (count > best_count) {
+      best = key;
+      best_count = count;
+    }
+  }
+  if (best_count == 0) {
+    throw std::invalid_argument(
+        "SignatureScanner: the signature has no checked bytes");
+  }
+  return best;
+}
+
+}  // namespace
+
+SignatureScanner::SignatureScanner(std::vector<Signature> signatures)
+    : signatures_(std::move(signatures)) {
+  for (std::size_t index = 0; index < signatures_.size(); index++) {
+    const Signature& signature = signatures_[index];
+    if (signature.data.empty())
+      throw std::invalid_argument("SignatureScanner: empty signature");
+    if (signature.max_diff != 0 && !signature.mask.empty()) {
+      throw std::invalid_argument(
+          "SignatureScanner: a loose signature cannot have a mask");
+    }
+
+    patterns_.push_back(signature.mask.empty()
+                            ? BytePattern{signature.data}
+                            : BytePattern{signature.data, signature.mask});
+
+    std::vector<WordKey> keys;
+    if (signature.max_diff != 0) {
+      keys = slice_loose_pattern(signature.data, signature.max_diff);
+      if (keys.empty()) {
+        throw std::invalid_argument(
+            "SignatureScanner: the loose signature is too short");
+      }
+    } else {
+      keys.push_back(SelectKey(signature));
+    }
+
+    for (const WordKey& key : keys) {
+      keys_.push_back(key);
+      key_owners_.push_back(index);
+      max_key_offset_ = std::max(max_key_offset_, key.offset);
+    }
+  }
+}
+
+SignatureScanner::Hits SignatureScanner::Scan(std::string_view rom) const {
+  Hits hits{NewHits()};
+  for (agbsize_t begin = 0; begin < rom.size(); begin += kScanWindow) {
+    const agbsize_t end = static_cast<agbsize_t>(
+        std::min<std::size_t>(rom.size(), begin + kScanWindow));
+    Scan(rom, begin, end, hits);
+  }
+  return hits;
+}
+
+void SignatureScanner::Scan(std::string_view rom, agbsize_t begin,
+                            agbsize_t end, Hits& hits) const {
+  if (hits.size() != size())
+    throw std::invalid_argument("SignatureScanner: hit list size mismatch");
+
+  begin = (begin + kAlign - 1) / kAlign * kAlign;
+  end = static_cast<agbsize_t>(std::min<std::size_t>(end, rom.size()));
+  if (begin >= end || keys_.empty()) return;
+
+  // The words from the first candidate to the last key of the last
+  // candidate. Only the last one may be cut off by the end of the ROM.
+  const std::size_t last_word =
+      std::min<std::size_t>(end - 1 + max_key_offset_, rom.size() - 1);
+  const std::size_t word_count = (last_word - begin) / kAlign + 1;
+  const std::size_t full_word_count =
+      std::min(word_count, (rom.size() - begin) / kAlign);
+
+  std::vector<std::size_t> word_hits;
+  find_words(rom.data() + begin, full_word_count, keys_.data(), keys_.size(),
+             word_hits);
+  if (full_word_count < word_count) {
+    word_hits.push_back(full_word_count);
+  }
+
+  std::vector<std::pair<std::size_t, agbsize_t>> candidates;
+  for (std::size_t hit : word_hits) {
+    const std::size_t word_pos = begin + hit * kAlign;
+    const std::uint32_t word = ReadWord(rom, word_pos);
+    for (std::size_t j = 0; j < keys_.size(); j++) {
+      const WordKey& key = keys_[j];
+      if ((word & key.mask) != key.value || word_pos < key.offset) continue;
+      const auto candidate = static_cast<agbsize_t>(word_pos - key.offset);
+      if (candidate < begin || candidate >= end) continue;
+      candidates.emplace_back(key_owners_[j], candidate);
+    }
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+  const auto last = std::unique(candidates.begin(), candidates.end());
+  for (auto it = candidates.begin(); it != last; ++it) {
+    if (Verify(rom, it->first, it->second))
+      hits[it->first].push_back(it->second);
+  }
+}
+
+bool SignatureScanner::Verify(std::string_view rom, std::size_t index,
+                              agbsize_t offset) const {
+  const Signature& signature = signatures_[index];
+  if (signature.max_diff == 0) return patterns_[index].Match(rom, offset);
+
+  // As in the original linear search, a match may not end at the end of the
+  // ROM.
+  const std::size_t size = signature.data.size();
+  if (rom.size() < size || offset >= rom.size() - size) return false;
+  return memcmp_loose(&rom[offset], signature.data.data(), size,
+                      signature.max_diff);
+}
+
+}  // namespace saptapper
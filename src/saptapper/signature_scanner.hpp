@@ -0,0 +1,79 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_SIGNATURE_SCANNER_HPP_
+#define SAPTAPPER_SIGNATURE_SCANNER_HPP_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "algorithm.hpp"
+#include "byte_pattern.hpp"
+#include "fixed_byte_pattern.hpp"
+#include "types.hpp"
+
+namespace saptapper {
+
+/// Finds a set of signatures at 4-byte-aligned positions in one pass.
+///
+/// Every signature is keyed by aligned words of itself: the word with the
+/// most fixed bytes for an exact signature, or the slices of a loose one
+/// (see slice_loose_pattern). One sweep over the aligned words of the ROM
+/// matches all keys at once, and only the positions a key points to are
+/// verified against the full signature.
+class SignatureScanner {
+ public:
+  /// A signature to look for. Bytes whose mask character is '?' are ignored
+  /// (an empty mask checks every byte). A loose signature (max_diff != 0)
+  /// matches where it differs in fewer than max_diff bytes (memcmp_loose).
+  struct Signature {
+    std::string data;
+    std::string mask;
+    unsigned int max_diff = 0;
+  };
+
+  /// The sorted match positions of each signature, in signature order.
+  using Hits = std::vector<std::vector<agbsize_t>>;
+
+  explicit SignatureScanner(std::vector<Signature> signatures);
+
+  std::size_t size() const noexcept { return signatures_.size(); }
+
+  Hits NewHits() const { return Hits(size()); }
+
+  /// Scans the whole ROM.
+  Hits Scan(std::string_view rom) const;
+
+  /// Appends the matches at positions in [begin, end). The ranges must be
+  /// scanned in ascending order to keep the hit lists sorted.
+  void Scan(std::string_view rom, agbsize_t begin, agbsize_t end,
+            Hits& hits) const;
+
+  template <std::size_t Size>
+  static Signature MakeSignature(const FixedBytePattern<Size>& pattern) {
+    Signature signature;
+    for (std::size_t i = 0; i < Size; i++) {
+      signature.data.push_back(static_cast<char>(pattern.data(i)));
+      signature.mask.push_back(pattern.is_fixed(i) ? 'x' : '?');
+    }
+    return signature;
+  }
+
+ private:
+  std::vector<Signature> signatures_;
+  std::vector<BytePattern> patterns_;
+  std::vector<WordKey> keys_;
+
+  /// The signature that each key belongs to.
+  std::vector<std::size_t> key_owners_;
+
+  /// The largest key offset.
+  agbsize_t max_key_offset_ = 0;
+
+  bool Verify(std::string_view rom, std::size_t index,
+              agbsize_t offset) const;
+};
+
+}  // namespace saptapper
+
+#endif
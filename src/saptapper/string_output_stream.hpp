@@ -0,0 +1,94 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_STRING_OUTPUT_STREAM_HPP_
+#define SAPTAPPER_STRING_OUTPUT_STREAM_HPP_
+
+#include <algorithm>
+#include <ios>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <utility>
+
+namespace saptapper {
+
+/// An output stream into a string, like std::ostringstream, except that the
+/// string can be moved out with Release rather than copied by str(). It is
+/// seekable, so PsfWriter can fill in the header after the exe.
+class StringOutputStream : public std::ostream {
+ public:
+  StringOutputStream() : std::ostream(nullptr) { rdbuf(&buffer_); }
+
+  StringOutputStream(const StringOutputStream&) = delete;
+  StringOutputStream& operator=(const StringOutputStream&) = delete;
+
+  /// Returns the data written so far, and empties the stream for reuse.
+  std::string Release() {
+    std::string data;
+    data.swap(buffer_.data);
+    buffer_.position = 0;
+    clear();
+    return data;
+  }
+
+ private:
+  class Buffer : public std::streambuf {
+   public:
+    std::string data;
+    std::string::size_type position = 0;
+
+   protected:
+    int_type overflow(int_type c) override {
+      if (traits_type::eq_int_type(c, traits_type::eof()))
+        return traits_type::not_eof(c);
+      const char ch = traits_type::to_char_type(c);
+      Put(&ch, 1);
+      return c;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize count) override {
+      Put(s, static_cast<std::string::size_type>(count));
+      return count;
+    }
+
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction,
+                     std::ios_base::openmode which) override {
+      if ((which & std::ios_base::out) == 0) return pos_type(off_type(-1));
+
+      off_type base = 0;
+      if (direction == std::ios_base::cur) {
+        base = static_cast<off_type>(position);
+      } else if (direction == std::ios_base::end) {
+        base = static_cast<off_type>(data.size());
+      }
+      const off_type target = base + offset;
+      if (target < 0 || target > static_cast<off_type>(data.size()))
+        return pos_type(off_type(-1));
+
+      position = static_cast<std::string::size_type>(target);
+      return pos_type(target);
+    }
+
+    pos_type seekpos(pos_type target, std::ios_base::openmode which) override {
+      return seekoff(off_type(target), std::ios_base::beg, which);
+    }
+
+   private:
+    void Put(const char* s, std::string::size_type count) {
+      if (position == data.size()) {
+        data.append(s, count);
+      } else {
+        const std::string::size_type overwritten =
+            std::min(count, data.size() - position);
+        data.replace(position, overwritten, s, count);
+      }
+      position += count;
+    }
+  };
+
+  Buffer buffer_;
+};
+
+}  // namespace saptapper
+
+#endif
@@ -0,0 +1,139 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#include "zip_output_sink.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <zlib.h>
+#include "bytes.hpp"
+
+namespace saptapper {
+
+namespace {
+
+constexpr std::uint16_t kVersionNeeded = 10;  // 1.0: stored entries
+constexpr std::uint16_t kUtf8Flag = 0x0800;
+constexpr std::uint16_t kStored = 0;
+constexpr std::uint16_t kDosTime = 0;
+constexpr std::uint16_t kDosDate = (0 << 9) | (1 << 5) | 1;  // 1980-01-01
+
+}  // namespace
+
+ZipOutputSink::ZipOutputSink(const std::filesystem::path& path)
+    : file_(path, std::ios::out | std::ios::binary) {
+  file_.exceptions(std::ios::badbit);
+  if (!file_) {
+    throw std::filesystem::filesystem_error(
+        "Unable to create the file", path,
+        std::make_error_code(std::errc::io_error));
+  }
+}
+
+std::ostream& ZipOutputSink::CreateEntry(const std::string& name) {
+  if (entry_open_ || closed_)
+    throw std::logic_error("The ZIP archive is not ready for an entry.");
+  if (name.size() > 0xffff)
+    throw std::invalid_argument("The entry name is too long.");
+  if (records_.size() >= kMaximumEntries)
+    throw std::runtime_error("Too many entries for a ZIP archive.");
+
+  entry_.str(std::string{});
+  entry_.clear();
+  entry_name_ = name;
+  entry_open_ = true;
+  return entry_;
+}
+
+void ZipOutputSink::CloseEntry() {
+  if (!entry_open_) throw std::logic_error("No ZIP entry is open.");
+  entry_open_ = false;
+
+  const std::string data{entry_.str()};
+  if (offset_ + kLocalHeaderSize + entry_name_.size() + data.size() >
+      kMaximumOffset) {
+    throw std::runtime_error("The ZIP archive is too large.");
+  }
+
+  Record record;
+  record.name = std::move(entry_name_);
+  record.crc32 = static_cast<std::uint32_t>(
+      crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(data.data()),
+            static_cast<uInt>(data.size())));
+  record.size = static_cast<std::uint32_t>(data.size());
+  record.offset = static_cast<std::uint32_t>(offset_);
+
+  Write(NewLocalHeader(record));
+  Write(data);
+  records_.push_back(std::move(record));
+}
+
+void ZipOutputSink::Close() {
+  if (closed_) return;
+  if (entry_open_) throw std::logic_error("A ZIP entry is still open.");
+
+  const std::uint64_t directory_offset = offset_;
+  for (const Record& record : records_) Write(NewCentralHeader(record));
+  const std::uint64_t directory_size = offset_ - directory_offset;
+  if (offset_ + kEndRecordSize > kMaximumOffset)
+    throw std::runtime_error("The ZIP archive is too large.");
+
+  std::string end(kEndRecordSize, 0);
+  const auto count = static_cast<std::uint16_t>(records_.size());
+  WriteInt32L(&end[0], 0x06054b50);
+  WriteInt16L(&end[8], count);
+  WriteInt16L(&end[10], count);
+  WriteInt32L(&end[12], static_cast<std::uint32_t>(directory_size));
+  WriteInt32L(&end[16], static_cast<std::uint32_t>(directory_offset));
+  Write(end);
+
+  file_.close();
+  if (!file_) throw std::ios_base::failure("Unable to write the ZIP archive.");
+  closed_ = true;
+}
+
+void ZipOutputSink::Write(const std::string& data) {
+  file_.write(data.data(), data.size());
+  offset_ += data.size();
+}
+
+std::string ZipOutputSink::NewLocalHeader(const Record& record) {
+  std::string header(kLocalHeaderSize, 0);
+  WriteInt32L(&header[0], 0x04034b50);
+  WriteInt16L(&header[4], kVersionNeeded);
+  WriteInt16L(&header[6], kUtf8Flag);
+  WriteInt16L(&header[8], kStored);
+  WriteInt16L(&header[10], kDosTime);
+  WriteInt16L(&header[12], kDosDate);
+  WriteInt32L(&header[14], record.crc32);
+  WriteInt32L(&header[18], record.size);
+  WriteInt32L(&header[22], record.size);
+  WriteInt16L(&header[26], static_cast<std::uint16_t>(record.name.size()));
+  header += record.name;
+  return header;
+}
+
+std::string ZipOutputSink::NewCentralHeader(const Record& record) {
+  std::string header(kCentralHeaderSize, 0);
+  WriteInt32L(&header[0], 0x02014b50);
+  WriteInt16L(&header[4], kVersionNeeded);
+  WriteInt16L(&header[6], kVersionNeeded);
+  WriteInt16L(&header[8], kUtf8Flag);
+  WriteInt16L(&header[10], kStored);
+  WriteInt16L(&header[12], kDosTime);
+  WriteInt16L(&header[14], kDosDate);
+  WriteInt32L(&header[16], record.crc32);
+  WriteInt32L(&header[20], record.size);
+  WriteInt32L(&header[24], record.size);
+  WriteInt16L(&header[28], static_cast<std::uint16_t>(record.name.size()));
+  WriteInt32L(&header[42], record.offset);
+  header += record.name;
+  return header;
+}
+
+}  // namespace saptapper
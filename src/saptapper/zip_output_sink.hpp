@@ -0,0 +1,70 @@
+// Saptapper: Automated GSF ripper for MusicPlayer2000.
+
+#ifndef SAPTAPPER_ZIP_OUTPUT_SINK_HPP_
+#define SAPTAPPER_ZIP_OUTPUT_SINK_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "output_sink.hpp"
+
+namespace saptapper {
+
+/// Writes the entries into a ZIP archive, front to back without seeking.
+///
+/// The files of a GSF set are compressed already, so the entries are stored
+/// as they are. Each entry is kept in memory until it is closed, and then
+/// written with its local header in one go. Every entry is dated 1980-01-01
+/// so that the same set always makes the same archive.
+class ZipOutputSink : public OutputSink {
+ public:
+  explicit ZipOutputSink(const std::filesystem::path& path);
+
+  ZipOutputSink(const ZipOutputSink&) = delete;
+  ZipOutputSink& operator=(const ZipOutputSink&) = delete;
+
+  std::ostream& CreateEntry(const std::string& name) override;
+
+  void CloseEntry() override;
+
+  /// Writes the central directory. The archive is incomplete until then.
+  void Close() override;
+
+ private:
+  // ZIP64 is not supported, and neither are larger archives.
+  static constexpr std::uint64_t kMaximumOffset = 0xffffffff;
+  static constexpr std::size_t kMaximumEntries = 0xffff;
+
+  static constexpr std::size_t kLocalHeaderSize = 30;
+  static constexpr std::size_t kCentralHeaderSize = 46;
+  static constexpr std::size_t kEndRecordSize = 22;
+
+  struct Record {
+    std::string name;
+    std::uint32_t crc32;
+    std::uint32_t size;
+    std::uint32_t offset;
+  };
+
+  std::ofstream file_;
+  std::ostringstream entry_;
+  std::string entry_name_;
+  bool entry_open_ = false;
+  bool closed_ = false;
+  std::uint64_t offset_ = 0;
+  std::vector<Record> records_;
+
+  void Write(const std::string& data);
+
+  static std::string NewLocalHeader(const Record& record);
+  static std::string NewCentralHeader(const Record& record);
+};
+
+}  // namespace saptapper
+
+#endif